@@ -92,7 +92,9 @@
 #define configTICK_RATE_HZ                      ( ( TickType_t ) 1000 )
 #define configMAX_PRIORITIES                    ( 7 )
 #define configMINIMAL_STACK_SIZE                ( ( uint16_t ) 128 )
-#define configTOTAL_HEAP_SIZE                   ( ( size_t ) ( 3 * 1024 ) )
+#define configTOTAL_HEAP_SIZE                   ( ( size_t ) ( 32 * 1024 ) )
+/* ucHeap (task stacks, TCBs and queue storage) is defined in rtos_lib.c and placed in DTCM */
+#define configAPPLICATION_ALLOCATED_HEAP        1
 #define configMAX_TASK_NAME_LEN                 ( 16 )
 #define configUSE_TRACE_FACILITY                1
 #define configUSE_16_BIT_TICKS                  0
@@ -0,0 +1,38 @@
+/*
+ * agg.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Скользящие агрегаты по датчикам (min/max/среднее/СКО) на окне последних опросов.
+ *      Обновляются на каждом опросе за O(1) амортизированно: min/max - монотонные деки,
+ *      среднее и дисперсия - бегущие суммы значений и квадратов. Всё в целых числах.
+ */
+
+#ifndef AGG_H_
+#define AGG_H_
+
+#include <stdint.h>
+#include "sensors.h"
+
+//!Агрегаты считаются для первых AGG_SENSORS датчиков: состояние ~200 байт на датчик не помещается в RAM при 4096
+#ifndef AGG_SENSORS
+#define AGG_SENSORS		(SENSORS_MAX < 256 ? SENSORS_MAX : 256)
+#endif
+#define AGG_WINDOW_MAX	64	//!Степень двойки не больше 128 (позиции в деках хранятся по модулю 256)
+#define AGG_FRAC_BITS	8	//!Дробная часть среднего и СКО (Q8)
+
+typedef struct
+{
+	int8_t min;
+	int8_t max;
+	int16_t mean;		//!Q8
+	uint16_t stddev;	//!Q8
+} AggResult_t;
+
+void agg_update(const int8_t *values);
+int agg_set_window(int window);
+int agg_window(void);
+void agg_get(int first, int count, AggResult_t *out);
+
+#endif /* AGG_H_ */
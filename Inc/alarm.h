@@ -0,0 +1,41 @@
+/*
+ * alarm.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Пороговые тревоги по датчикам с гистерезисом. Проверяются на каждом опросе,
+ *      о каждом переходе состояния сервер узнаёт кадром тревоги без запроса.
+ */
+
+#ifndef ALARM_H_
+#define ALARM_H_
+
+#include <stdint.h>
+#include "sensors.h"
+
+#define ALARM_SENSORS		SENSORS_MAX
+#define ALARM_EVENTS_MAX	16	//!Переходов за один опрос, остальные попадут в следующий
+#define ALARM_FRAME_MARKER	0xFA	//!Первый байт кадра тревоги в MESS_BYTE
+
+//!Состояние датчика
+enum
+{
+	ALARM_NORMAL,
+	ALARM_LOW,
+	ALARM_HIGH
+};
+
+typedef struct
+{
+	uint16_t sensor;
+	uint8_t state;
+	int8_t value;
+	uint8_t prev;	//!Состояние до перехода (для alarm_revert)
+} AlarmEvent_t;
+
+int alarm_set(int sensor, int low, int high, int hysteresis);
+int alarm_check(const int8_t *values, AlarmEvent_t *events);
+void alarm_revert(const AlarmEvent_t *event);
+
+#endif /* ALARM_H_ */
@@ -0,0 +1,32 @@
+/*
+ * analog.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Аналоговые датчики (NTC 10 кОм, B = 3950, делитель с подтяжкой 10 кОм к Vref).
+ *      Таймер запускает последовательность преобразований всех каналов АЦП, DMA по кругу складывает результаты
+ *      в двойной буфер. Процессор занят только в прерывании половины/конца буфера: усреднение ANALOG_OVERSAMPLE
+ *      проходов и перевод кодов в температуру по таблице одним проходом по всем каналам.
+ *      На хосте вместо АЦП проигрывается записанная трасса кодов.
+ */
+
+#ifndef ANALOG_H_
+#define ANALOG_H_
+
+#include <stdint.h>
+#include "sensors.h"
+
+#define ANALOG_CHANNELS		5
+#define ANALOG_OVERSAMPLE	8	//!Проходов последовательности в половине буфера
+#define ANALOG_RATE_HZ		80	//!Запусков последовательности в секунду: половина буфера готова каждые 100 мс
+#ifndef ANALOG_FIRST
+#define ANALOG_FIRST		0	//!Номер датчика первого аналогового канала
+#endif
+
+int analog_init(void);
+int analog_read(int channel, int8_t *value);
+
+extern const SensorDriver_t analog_driver;	//!АЦП преобразует непрерывно, чтение отдаёт последние значения
+
+#endif /* ANALOG_H_ */
@@ -0,0 +1,37 @@
+/*
+ * calib.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Калибровка датчиков: необязательная кусочно-линейная кривая (одна из CALIB_CURVES общих),
+ *      затем коэффициент и смещение датчика: y = curve(x) * (1 + gain / 256) + offset / 4.
+ *      Применяется ко всему снимку одним проходом после опроса, некалиброванные датчики копируются словами
+ *      по четыре, коэффициент и смещение на Cortex-M7 считаются SIMD (SMLAD на датчик). Таблица лежит в PSRAM
+ *      (RAM_EXT) и хранится в последнем секторе QSPI FLASH двумя копиями, которые пишутся по очереди:
+ *      сброс во время записи не теряет сохранённую ранее таблицу.
+ */
+
+#ifndef CALIB_H_
+#define CALIB_H_
+
+#include <stdint.h>
+#include "sensors.h"
+#include "flashlog.h"
+
+#define CALIB_SENSORS		SENSORS_MAX
+#define CALIB_CURVES		4	//!Кривые 1..CALIB_CURVES, 0 - без кривой
+#define CALIB_POINTS		8
+#define CALIB_GAIN_FRAC		8	//!gain: отклонение коэффициента от 1 в 1/256
+#define CALIB_OFFSET_FRAC	2	//!offset: смещение в 1/4 °C
+#define CALIB_FLASH_ADDR	(FLASHLOG_SECTORS * FLASHLOG_SECTOR_SIZE)
+#define CALIB_BENCH			256	//!Датчиков в замере calib_bench
+
+int calib_load(void);
+int calib_save(void);
+int calib_set(int sensor, int gain, int offset, int curve);
+int calib_point(int curve, int point, int x, int y);
+int calib_apply(const int8_t *raw, int8_t *out, int count);
+void calib_bench(uint32_t *simdCycles, uint32_t *scalarCycles);
+
+#endif /* CALIB_H_ */
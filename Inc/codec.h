@@ -0,0 +1,103 @@
+/*
+ * codec.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Кодеки сжатия снимков температур
+ */
+
+#ifndef CODEC_H_
+#define CODEC_H_
+
+#include <stdint.h>
+
+//!Полубайтовая дельта: разность с предыдущим снимком -7..+7 кодируется полубайтом,
+//!остальные значения - полубайтом CODEC_NIBBLE_ESCAPE и двумя полубайтами исходного значения
+#define CODEC_NIBBLE_ESCAPE 0x8
+//!Максимальный размер результата codec_delta_encode для count значений
+#define CODEC_DELTA_MAX(count) (((count) * 3 + 1) / 2)
+
+int codec_delta_encode(const int8_t *cur, const int8_t *prev, int count, uint8_t *out);
+int codec_delta_size(const int8_t *cur, const int8_t *prev, int count);
+int codec_delta_decode(const uint8_t *in, int len, const int8_t *prev, int count, int8_t *cur);
+
+//!Канонический код Хаффмана для разностей с предыдущим снимком. Символ s < CODEC_HUFF_ESCAPE - разность
+//!s - CODEC_HUFF_DELTA_MAX, символ CODEC_HUFF_ESCAPE - следом 8 бит исходного значения. Код задаётся только длинами
+//!кодов символов (0 - у символа нет кода, вместо него escape), коды назначаются по возрастанию длины, затем номера
+//!символа и пишутся старшим битом вперёд. Таблицу строит хост по записанным данным (codec_huff_build)
+#define CODEC_HUFF_DELTA_MAX	15
+#define CODEC_HUFF_ESCAPE		(CODEC_HUFF_DELTA_MAX * 2 + 1)
+#define CODEC_HUFF_SYMBOLS		(CODEC_HUFF_ESCAPE + 1)
+#define CODEC_HUFF_MAX_LEN		12	//!Длина кода помещается в полубайт, таблица декодера - 2^12 записей
+
+typedef struct
+{
+	uint16_t code[CODEC_HUFF_SYMBOLS];
+	uint8_t len[CODEC_HUFF_SYMBOLS];
+} HuffTable_t;
+
+//!Таблица декодера: по следующим CODEC_HUFF_MAX_LEN битам - символ (старшие биты) и длина кода (младшие 4 бита)
+typedef struct
+{
+	uint16_t lut[1 << CODEC_HUFF_MAX_LEN];
+} HuffDecoder_t;
+
+int codec_huff_table(const uint8_t *lengths, HuffTable_t *table);
+int codec_huff_encode(const HuffTable_t *table, const int8_t *cur, const int8_t *prev, int count, uint8_t *out, int max);
+void codec_huff_build(const uint32_t *counts, uint8_t *lengths);
+int codec_huff_decoder(const uint8_t *lengths, HuffDecoder_t *decoder);
+int codec_huff_decode(const HuffDecoder_t *decoder, const uint8_t *in, int len, const int8_t *prev, int count, int8_t *cur);
+
+uint16_t codec_crc16(uint16_t crc, const uint8_t *data, int len);
+
+//!COBS: данные без нулей - блоками до CODEC_COBS_BLOCK байт, перед блоком байт (длина + 1), в конце кадра 0x00.
+//!Потоковый кодер копит не больше одного блока и отдаёт закодированные байты через out.
+//!Накладные расходы - байт на каждые 254 байта данных, плюс байт длины последнего блока и разделитель
+#define CODEC_COBS_BLOCK	254
+#define CODEC_COBS_MAX(len)	((len) + (len) / CODEC_COBS_BLOCK + 2)
+
+typedef struct
+{
+	uint8_t block[CODEC_COBS_BLOCK];
+	int len;
+	void (*out)(const uint8_t *data, int len);
+} CobsEncoder_t;
+
+void codec_cobs_begin(CobsEncoder_t *cobs, void (*out)(const uint8_t *data, int len));
+void codec_cobs_put(CobsEncoder_t *cobs, const uint8_t *data, int len);
+void codec_cobs_end(CobsEncoder_t *cobs);
+
+//!Сжатие потока LZSS (как heatshrink). Кольцо кодера - 2^CODEC_LZ_WINDOW_BITS последних байт: окно повторов
+//!и ещё не закодированные байты. Повтор длиной CODEC_LZ_MIN_MATCH..CODEC_LZ_MATCH_MAX со смещением до CODEC_LZ_OFFSET_MAX -
+//!бит 0, смещение - 1 (CODEC_LZ_WINDOW_BITS бит), длина - CODEC_LZ_MIN_MATCH (CODEC_LZ_LENGTH_BITS бит), остальные
+//!байты - бит 1 и 8 бит байта. Биты старшим вперёд. Конец потока - повтор с полем смещения из одних единиц,
+//!затем нули до границы байта. Поток без данных не занимает ни одного байта
+#ifndef CODEC_LZ_WINDOW_BITS
+#define CODEC_LZ_WINDOW_BITS	8
+#endif
+#ifndef CODEC_LZ_LENGTH_BITS
+#define CODEC_LZ_LENGTH_BITS	4
+#endif
+#define CODEC_LZ_WINDOW			(1 << CODEC_LZ_WINDOW_BITS)
+#define CODEC_LZ_MIN_MATCH		((CODEC_LZ_WINDOW_BITS + CODEC_LZ_LENGTH_BITS + 1) / 9 + 1)	//!Повтор короче литералов
+#define CODEC_LZ_MATCH_MAX		(CODEC_LZ_MIN_MATCH + (1 << CODEC_LZ_LENGTH_BITS) - 1)
+#define CODEC_LZ_OFFSET_MAX		(CODEC_LZ_WINDOW - CODEC_LZ_MATCH_MAX - 1)
+//!Максимальный размер результата codec_lz_put для len байт и codec_lz_end
+#define CODEC_LZ_MAX(len)		(((len) + CODEC_LZ_MATCH_MAX) * 9 / 8 + (CODEC_LZ_WINDOW_BITS + CODEC_LZ_LENGTH_BITS) / 8 + 3)
+
+typedef struct
+{
+	uint8_t ring[CODEC_LZ_WINDOW];
+	uint32_t head;	//!Принято байт потока
+	uint32_t pos;	//!Закодировано байт потока
+	uint32_t acc;	//!Накопитель бит, ещё не выданных в out
+	int bits;
+} LzEncoder_t;
+
+void codec_lz_begin(LzEncoder_t *lz);
+int codec_lz_put(LzEncoder_t *lz, const uint8_t *data, int len, uint8_t *out);
+int codec_lz_end(LzEncoder_t *lz, uint8_t *out);
+int codec_lz_decode(const uint8_t *in, int len, uint8_t *out, int max, int *used);
+
+#endif /* CODEC_H_ */
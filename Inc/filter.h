@@ -0,0 +1,28 @@
+/*
+ * filter.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Сглаживание сырых значений датчиков между драйвером и снимком: медиана из трёх последних чтений
+ *      (подавление одиночных выбросов), затем экспоненциальное среднее с коэффициентом 1 / 2^shift.
+ *      На Cortex-M7 четыре датчика обрабатываются за инструкцию (SIMD: SSUB8/SEL/SHADD8),
+ *      на хосте - скалярная версия с тем же результатом до бита.
+ */
+
+#ifndef FILTER_H_
+#define FILTER_H_
+
+#include <stdint.h>
+#include "sensors.h"
+
+#define FILTER_SENSORS		SENSORS_MAX
+#define FILTER_SHIFT_MAX	4
+#define FILTER_BENCH		256	//!Датчиков в замере filter_bench
+
+void filter_set(int shift);
+int filter_enabled(void);
+void filter_run(int first, int count, int8_t *values, const uint8_t *mask);
+void filter_bench(uint32_t *simdCycles, uint32_t *scalarCycles);
+
+#endif /* FILTER_H_ */
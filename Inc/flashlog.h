@@ -0,0 +1,65 @@
+/*
+ * flashlog.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Журнал снимков температур во внешней QSPI FLASH.
+ *      Кадры (заголовок LogFrame_t + сжатые данные) дописываются в поток байт, который пишется
+ *      только целыми страницами. FLASH поделена на сектора, заполняемые по кругу: следующий
+ *      за текущим сектор заранее стирается по блоку на каждый кадр (самый старый сектор отдаётся
+ *      под запись). Первый кадр каждого сектора - опорный, остальные кодируются дельтой к предыдущему.
+ */
+
+#ifndef FLASHLOG_H_
+#define FLASHLOG_H_
+
+#include <stdint.h>
+#include "sensors.h"
+
+#define FLASHLOG_SENSORS_MAX		SENSORS_MAX
+#define FLASHLOG_SECTOR_SIZE		0x10000
+#define FLASHLOG_SECTORS			1023	//!Последний сектор FLASH - калибровка (calib.c)
+#define FLASHLOG_KEYFRAME_INTERVAL	64	//!Опорный кадр не реже чем раз в столько кадров
+#define FLASHLOG_FRAME_MAGIC		0xA5
+#define FLASHLOG_NONE				0xFFFFFFFF
+
+//!Способ кодирования данных кадра
+enum
+{
+	FLASHLOG_KEY,	//!Значения int8_t как есть
+	FLASHLOG_DELTA,	//!codec_delta_encode относительно предыдущего кадра
+	FLASHLOG_HUFF	//!Метка таблицы uint16 (CRC-16 длин кодов), затем codec_huff_encode относительно предыдущего кадра
+};
+
+//!Замеры кодирования дельта-кадров с последней загрузки таблицы (команда codec)
+enum
+{
+	FLASHLOG_FRAMES,		//!Дельта-кадров
+	FLASHLOG_RAW_BYTES,		//!Их значения как есть
+	FLASHLOG_NIBBLE_BYTES,	//!Те же кадры полубайтовой дельтой
+	FLASHLOG_WRITTEN_BYTES,	//!Фактически записано (код Хаффмана с меткой или полубайтовая дельта, что короче)
+	FLASHLOG_TABLE,			//!Метка загруженной таблицы, 0 - нет
+	FLASHLOG_STATS
+};
+
+//!Заголовок кадра, в таком же виде кадры отдаются по команде history
+typedef struct
+{
+	uint8_t magic;
+	uint8_t codec;
+	uint16_t count;	//!Количество датчиков
+	uint16_t len;	//!Длина данных после заголовка
+	uint16_t crc;	//!CRC-16 заголовка (с crc = 0) и данных
+	uint32_t epoch;	//!Номер опроса датчиков
+} LogFrame_t;
+
+int flashlog_init(void);
+uint32_t flashlog_last_epoch(void);
+int flashlog_append(uint32_t epoch, const int8_t *values, int count);
+int flashlog_history(uint32_t from, uint32_t to, void (*send)(const uint8_t *data, int len));
+int flashlog_huff_set(const uint8_t *lengths);
+void flashlog_codec_stats(uint32_t *out);
+int flashlog_locked(int (*job)(void));
+
+#endif /* FLASHLOG_H_ */
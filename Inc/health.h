@@ -0,0 +1,44 @@
+/*
+ * health.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Контроль исправности датчиков: подряд идущие ошибки чтения, выход за физический диапазон,
+ *      невозможные скачки между опросами и залипание на одном значении. Неисправный датчик уходит
+ *      в карантин: его значения не принимаются, а опрашивается он с нарастающей паузой.
+ *      Из карантина датчик выходит после HEALTH_RECOVER_READS подряд исправных чтений.
+ */
+
+#ifndef HEALTH_H_
+#define HEALTH_H_
+
+#include <stdint.h>
+#include "sensors.h"
+
+#define HEALTH_SENSORS			SENSORS_MAX
+#define HEALTH_RANGE_MIN		-55		//!Диапазон DS18B20/TMP102, °C
+#define HEALTH_RANGE_MAX		125
+#define HEALTH_JUMP_DEFAULT		20		//!Максимальное изменение между чтениями, °C
+#define HEALTH_BAD_READS		3		//!Плохих чтений подряд до карантина
+#define HEALTH_RECOVER_READS	3		//!Исправных чтений подряд для выхода из карантина
+#define HEALTH_BACKOFF_MIN		2000	//!Пауза опроса в карантине, мс, удваивается до max
+#define HEALTH_BACKOFF_MAX		60000
+
+//!Причины неисправности (битовая маска)
+enum
+{
+	HEALTH_FAIL = 0x01,		//!Ошибка чтения
+	HEALTH_RANGE = 0x02,	//!Значение вне физического диапазона
+	HEALTH_JUMP = 0x04,		//!Скачок больше допустимого
+	HEALTH_STUCK = 0x08		//!Значение не меняется дольше допустимого
+};
+
+void health_set(int stuckReads, int jump);
+int health_check(int sensor, int ok, int8_t value, int8_t accepted);
+int health_quarantined(int sensor);
+uint8_t health_reason(int sensor);
+uint32_t health_backoff(int sensor);
+int health_bitmap(int first, int count, uint8_t *out);
+
+#endif /* HEALTH_H_ */
@@ -0,0 +1,31 @@
+/*
+ * histring.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Кольцевой буфер истории значений датчиков во внешней PSRAM.
+ *      Раскладка по датчикам: история одного датчика лежит подряд (HISTRING_DEPTH значений),
+ *      все датчики пишутся в одну и ту же позицию кольца. Запись - один процесс (опрос датчиков),
+ *      чтение без блокировок: после копирования читатель проверяет, что запись не успела
+ *      затереть прочитанный диапазон.
+ */
+
+#ifndef HISTRING_H_
+#define HISTRING_H_
+
+#include <stdint.h>
+#include "sensors.h"
+#include "mpuinit.h"
+
+#define HISTRING_SIZE		PSRAM_RING_SIZE	//!432 КБ PSRAM
+#define HISTRING_SENSORS	SENSORS_MAX
+#define HISTRING_DEPTH		(HISTRING_SIZE / HISTRING_SENSORS)	//!Значений на датчик: 1728 при 256 датчиках, 108 при 4096
+#define HISTRING_GUARD		2		//!Позиции у головы кольца, недоступные читателю (идёт запись)
+
+int histring_init(void);
+void histring_append(const int8_t *values);
+uint32_t histring_head(void);
+int histring_read(int sensor, uint32_t first, int count, int8_t *out);
+
+#endif /* HISTRING_H_ */
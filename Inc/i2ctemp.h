@@ -0,0 +1,50 @@
+/*
+ * i2ctemp.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Датчики температуры на I2C (TMP102, LM75 и совместимые): регистр 0x00, 2 байта, старший - целые градусы.
+ *      Датчики преобразуют непрерывно, опрос - цепочка чтений регистра через DMA. Следующее чтение запускается
+ *      из прерывания окончания предыдущего, процесс опроса только ставит набор датчиков и проверяет готовность.
+ *      На хосте вместо I2C работает имитация шины со счётом времени на проводе.
+ */
+
+#ifndef I2CTEMP_H_
+#define I2CTEMP_H_
+
+#include <stdint.h>
+#include "sensors.h"
+#include "analog.h"
+
+#ifndef I2CTEMP_SENSORS
+#define I2CTEMP_SENSORS		8		//!Устройств на шине
+#endif
+#ifndef I2CTEMP_ADDR_FIRST
+#define I2CTEMP_ADDR_FIRST	0x48	//!Адрес первого устройства, остальные - подряд
+#endif
+#ifndef I2CTEMP_FIRST
+#define I2CTEMP_FIRST		(ANALOG_FIRST + ANALOG_CHANNELS)	//!Номер датчика первого устройства
+#endif
+#define I2CTEMP_REG			0x00	//!Регистр температуры
+
+#if I2CTEMP_ADDR_FIRST < 0x08 || I2CTEMP_ADDR_FIRST + I2CTEMP_SENSORS - 1 > 0x77
+#error "I2C sensor addresses must fit into 0x08..0x77"
+#endif
+
+//!Замеры последней цепочки чтений
+enum
+{
+	I2CTEMP_READS,		//!Прочитано устройств
+	I2CTEMP_ERRORS,		//!Не ответили
+	I2CTEMP_CYCLES,		//!Такты процессора в прерываниях окончания
+	I2CTEMP_TIME_US,	//!Длительность цепочки, мкс
+	I2CTEMP_STATS
+};
+
+int i2ctemp_init(void);
+void i2ctemp_stats(uint32_t *stats);
+
+extern const SensorDriver_t i2ctemp_driver;
+
+#endif /* I2CTEMP_H_ */
@@ -9,7 +9,111 @@
 #define MPUINIT_H_
 
 #include <stdint.h>
+#include "ring.h"
+
+//!Размещение горячих данных и кода в памяти ядра без wait-state (DTCM/ITCM)
+//!Секции .dtcm и .itcm описаны в STM32F723IEKx_FLASH.ld, TCM_DISABLE возвращает всё в SRAM/FLASH для сравнения
+#if defined(STM32_BUILD) && !defined(TCM_DISABLE)
+#define RAM_D_TCM	__attribute__((section(".dtcm")))
+#define RAM_I_TCM	__attribute__((section(".itcm"), noinline))
+#else
+#define RAM_D_TCM
+#define RAM_I_TCM
+#endif
+
+//!Буферы DMA: некэшируемая область SRAM2 (регион MPU), выравнивание на строку кэша
+#define CACHE_LINE_SIZE 32
+#define CACHE_ALIGNED	__attribute__((aligned(CACHE_LINE_SIZE)))
+#ifdef STM32_BUILD
+#define RAM_DMA		__attribute__((section(".dma_buffer"), aligned(CACHE_LINE_SIZE)))
+#else
+#define RAM_DMA		CACHE_ALIGNED
+#endif
+
+//!Обслуживание D-cache для DMA-буферов в кэшируемой памяти. Адрес и размер должны быть кратны строке кэша,
+//!иначе invalidate затрёт соседние данные. Макросы проверяют это при компиляции по типу объекта
+#define CACHE_CHECK(buf)	_Static_assert(sizeof(buf) % CACHE_LINE_SIZE == 0 && __alignof__(buf) >= CACHE_LINE_SIZE, \
+									"DMA buffer must be CACHE_ALIGNED and a multiple of CACHE_LINE_SIZE")
+//!Перед запуском передачи из памяти (TX): выгрузить кэш в память
+#define CACHE_CLEAN(buf)		do { CACHE_CHECK(buf); cache_clean(&(buf), sizeof(buf)); } while (0)
+//!После приёма в память (RX): сбросить устаревшие строки кэша
+#define CACHE_INVALIDATE(buf)	do { CACHE_CHECK(buf); cache_invalidate(&(buf), sizeof(buf)); } while (0)
+
 void mpu_init(void);
-void uart_init(void (*uart_RxCallBack)(void), void (*uart_TxCallBack)(void), uint8_t *Rx, uint8_t *Tx);
+//!Последовательные порты 8N1 на UART_BAUD_DEFAULT: 0 - UART4 (PH13 - TX, PH14 - RX), 1 - USART6 (виртуальный COM-порт
+//!ST-LINK, PC6/PC7), 2 - USART2 (PA2 - TX, PA3 - RX)
+#define UART_PORTS					3
+#define UART_BAUD_DEFAULT			115200
+#define UART_BAUD_ERROR_PERMILLE	20	//!Допустимое отклонение фактической скорости от заданной, 1/1000
+//!Прерывания порта переносят байты между регистром данных и кольцами rx/tx (размер - степень двойки).
+//!uart_Event(port) вызывается из прерывания, когда принят '\n' или кольцо приёма заполнено наполовину.
+//!Передача из кольца tx идёт до его опустошения, после записи в кольцо - uart_tx_kick
+#ifndef UART_LL
+#define UART_LL						1	//!Обработчики прерываний на регистрах (LL), 0 - через HAL_UART_IRQHandler
+#endif
+void uart_init(int port, Ring_t *rx, Ring_t *tx, void (*uart_Event)(int port));
+//!Смена скорости порта: делитель от фактической частоты PCLK, при USARTDIV < 16 - передискретизация 8
+//!(UART4 - до PCLK1 / 8 = 6.75 Мбод). 0 - скорость недостижима с отклонением не больше UART_BAUD_ERROR_PERMILLE
+int uart_baud_valid(int port, uint32_t baud);
+int uart_set_baud(int port, uint32_t baud);
+//!Передатчик порта закончил последний байт (можно менять скорость)
+int uart_tx_idle(int port);
+void uart_tx_kick(int port);
+void uart_isr_stats(int port, uint32_t *bytes, uint32_t *cycles);
+//!Аппаратное управление потоком RTS/CTS, только UART4 (CTS - PB0, RTS - PA15)
+int uart_set_flow(int port, int on);
+//!АЦП: последовательность каналов (номера входов ADC1) по триггеру таймера rateHz раз в секунду,
+//!DMA по кругу в buffer на length отсчётов. callback(0/1) из прерывания DMA, когда готова первая/вторая половина
+int adc_scan_init(const uint8_t *channels, int count, uint16_t *buffer, int length, int rateHz, void (*adc_CallBack)(int half));
+//!I2C2 (разъём Arduino, PH4/PH5) 400 кГц. Чтение регистра устройства через DMA, callback(0) из прерывания по окончании,
+//!callback(1) - ошибка (NACK, потеря арбитража). Следующее чтение можно запускать прямо из callback
+int i2c_init(void (*i2c_CallBack)(int error));
+int i2c_read_dma(uint8_t address, uint8_t reg, uint8_t *data, int length);
+//!1-Wire: до 4 цепочек на выводах PB14, PB15, PB4, PB7 (open-drain, внешняя подтяжка 4.7 кОм), бит i - цепочка i.
+//!onewire_drive прижимает к нулю цепочки low и отпускает остальные, onewire_sample - уровни линий (1 - отпущена).
+//!onewire_timer - однократный вызов callback из прерывания TIM5 через us мкс (таймер TIM5 и выводы настраивает onewire_bus_init)
+int onewire_bus_init(int chains, void (*ow_CallBack)(void));
+void onewire_drive(uint32_t low);
+uint32_t onewire_sample(void);
+void onewire_timer(uint32_t us);
+
+//!Счётчик тактов ядра (DWT CYCCNT) для замеров
+void cycle_counter_init(void);
+uint32_t cycle_counter_get(void);
+
+//!Внешняя QSPI FLASH (MX25L512, 64 МБ): запись страницами по 256 байт, стирание блоками по 4 КБ
+#define QSPI_PAGE_SIZE		256
+#define QSPI_ERASE_SIZE		0x1000
+#define QSPI_FLASH_SIZE		0x4000000
+int qspi_init(void);
+int qspi_read(uint32_t addr, void *data, uint32_t size);
+int qspi_write(uint32_t addr, const void *data, uint32_t size);
+int qspi_erase(uint32_t addr);
+
+//!Внешняя PSRAM (512 КБ на FMC), доступ через адресное пространство. Возвращает базовый адрес или 0.
+//!Первые PSRAM_RING_SIZE байт - кольцо истории (histring), остаток - статические холодные таблицы RAM_EXT
+//!(секция .psram в STM32F723IEKx_FLASH.ld). RAM_EXT не обнуляется в startup и доступна только после ram_ext_init
+#define PSRAM_RING_SIZE		0x6C000
+#ifdef STM32_BUILD
+#define RAM_EXT		__attribute__((section(".psram")))
+#else
+#define RAM_EXT
+#endif
+void *psram_init(uint32_t *size);
+int ram_ext_init(void);
+
+//!Барьер памяти между записью данных и публикацией индекса для читателей без блокировок
+#ifdef STM32_BUILD
+#define memory_barrier()	__asm volatile ("dmb" ::: "memory")
+#else
+#define memory_barrier()	__sync_synchronize()
+#endif
+
+//!CRC-32 (IEEE 802.3, как в zlib) на периферии CRC: полином 0x04C11DB7, отражение входа и выхода, финальная инверсия
+int crc_init(void);
+uint32_t crc32_calc(const void *data, uint32_t size);
+
+void cache_clean(const void *addr, uint32_t size);
+void cache_invalidate(void *addr, uint32_t size);
 
 #endif /* MPUINIT_H_ */
@@ -0,0 +1,46 @@
+/*
+ * onewire.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Датчики DS18B20 на цепочках 1-Wire. Все цепочки работают одновременно одной последовательностью слотов,
+ *      каждая на своём выводе. Цикл опроса: Skip ROM + Convert T всем устройствам сразу, ожидание преобразования,
+ *      затем Match ROM + Read Scratchpad устройств подряд. Слоты отсчитывает таймер, процессор занят только
+ *      в его прерываниях. На хосте вместо выводов работает имитация цепочек с устройствами.
+ */
+
+#ifndef ONEWIRE_H_
+#define ONEWIRE_H_
+
+#include <stdint.h>
+#include "sensors.h"
+#include "i2ctemp.h"
+
+#ifndef ONEWIRE_CHAINS
+#define ONEWIRE_CHAINS		2		//!Цепочек (выводов), до 4
+#endif
+#ifndef ONEWIRE_DEVICES
+#define ONEWIRE_DEVICES		4		//!Устройств на цепочке
+#endif
+#ifndef ONEWIRE_FIRST
+#define ONEWIRE_FIRST		(I2CTEMP_FIRST + I2CTEMP_SENSORS)	//!Номер датчика первого устройства первой цепочки
+#endif
+#define ONEWIRE_SENSORS		(ONEWIRE_CHAINS * ONEWIRE_DEVICES)	//!Датчик ONEWIRE_FIRST + цепочка * ONEWIRE_DEVICES + устройство
+#define ONEWIRE_CONVERT_US	750000	//!Преобразование 12 бит
+
+#if ONEWIRE_CHAINS < 1 || ONEWIRE_CHAINS > 4
+#error "ONEWIRE_CHAINS must be 1..4"
+#endif
+
+int onewire_init(void);
+int onewire_bind(int sensor, uint64_t rom);
+int onewire_rom(int sensor, uint64_t *rom);
+#ifndef STM32_BUILD
+//!Имитация: продвинуть время хоста на us мкс, события цепочек до этого момента обрабатываются
+void onewire_sim_advance(uint32_t us);
+#endif
+
+extern const SensorDriver_t onewire_driver;
+
+#endif /* ONEWIRE_H_ */
@@ -0,0 +1,33 @@
+/*
+ * poll.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Планировщик опроса датчиков. В фиксированном режиме все датчики опрашиваются с одним периодом.
+ *      В адаптивном режиме у каждого датчика свой интервал между min и max: при изменении значения
+ *      интервал сбрасывается в min, пока значение стоит - удваивается до max. Таймер опроса тикает
+ *      с периодом min, на каждом тике читаются только датчики, у которых подошёл срок.
+ */
+
+#ifndef POLL_H_
+#define POLL_H_
+
+#include <stdint.h>
+#include "sensors.h"
+
+#define POLL_SENSORS		SENSORS_MAX
+#define POLL_PERIOD_MIN		100		//!мс
+#define POLL_PERIOD_MAX		2000	//!мс
+#define POLL_PUBLISH_MS		1000	//!Период публикации снимка (история, журнал) в адаптивном режиме
+
+int poll_configure(int minMs, int maxMs, uint32_t now);
+int poll_tick_ms(void);
+int poll_publish_ms(void);
+int poll_is_due(int sensor, uint32_t now);
+void poll_done(int sensor, uint32_t now, int changed);
+void poll_defer(int sensor, uint32_t now, uint32_t delayMs);
+void poll_tick(uint32_t now);
+uint32_t poll_load(void);
+
+#endif /* POLL_H_ */
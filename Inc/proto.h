@@ -0,0 +1,36 @@
+/*
+ * proto.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Кадры ответов: заголовок (sync, тип, номер, эпоха, длина), данные и CRC-32 с периферии CRC.
+ *      Последние кадры хранятся в окне повтора в PSRAM: по команде nack кадр отправляется ещё раз как есть,
+ *      без повторной упаковки снимка. Номера кадров у каждого канала свои, окно повтора общее:
+ *      кадр в нём помечен каналом, и повторяется только каналу, которому был отправлен.
+ */
+
+#ifndef PROTO_H_
+#define PROTO_H_
+
+#include <stdint.h>
+
+#define PROTO_SYNC			0xA5
+#define PROTO_HEADER		10		//!sync (1), тип (1), номер (2), эпоха (4), длина данных (2); little-endian
+#define PROTO_CRC			4		//!CRC-32 заголовка и данных, little-endian
+#define PROTO_PAYLOAD_MAX	1536	//!Длинные ответы делятся на несколько кадров
+#define PROTO_WINDOW_SIZE	8192	//!Байт окна повтора (не меньше 5 кадров наибольшей длины)
+#define PROTO_WINDOW_FRAMES	16
+
+//!Режим ответов
+enum
+{
+	PROTO_RAW,		//!Поток байт без кадров
+	PROTO_FRAMED
+};
+
+int proto_init(void);
+int proto_frame(uint8_t link, uint16_t seq, uint8_t type, uint32_t epoch, const uint8_t *data, int len, const uint8_t **frame);
+int proto_resend(uint8_t link, uint16_t number, const uint8_t **frame);
+
+#endif /* PROTO_H_ */
@@ -0,0 +1,32 @@
+/*
+ * registry.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Реестр устройств: 64-битный ID на шине (ROM-код 1-Wire, адрес I2C с номером шины) -> номер датчика (слот).
+ *      Поиск по ID - хеш-таблица с открытой адресацией (линейное пробирование), заполнение не больше половины.
+ *      Слоты выдаются наименьшие свободные и не меняются при добавлении и удалении других устройств.
+ *      Датчики 1-Wire привязываются к ROM-кодам через реестр: ID в слоте такого датчика - ROM-код его устройства.
+ *      Таблицы лежат в PSRAM (RAM_EXT) и доступны только после psram_init.
+ */
+
+#ifndef REGISTRY_H_
+#define REGISTRY_H_
+
+#include <stdint.h>
+#include "sensors.h"
+
+#define REGISTRY_SLOTS		SENSORS_MAX
+#define REGISTRY_TABLE		(REGISTRY_SLOTS * 2)
+#define REGISTRY_NONE		-1
+
+int registry_init(void);
+int registry_add(uint64_t id);
+int registry_add_at(uint64_t id, int slot);
+int registry_remove(uint64_t id);
+int registry_find(uint64_t id);
+int registry_id(int slot, uint64_t *id);
+int registry_count(void);
+
+#endif /* REGISTRY_H_ */
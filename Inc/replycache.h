@@ -0,0 +1,35 @@
+/*
+ * replycache.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Кэш упакованных порций ответа read. Ключ - версия снимка, формат и диапазон датчиков порции.
+ *      Порции лежат в буфере подряд, порция, не поместившаяся в буфер, не кэшируется. Новая версия снимка
+ *      сбрасывает кэш целиком. Кэшем пользуется только процесс UART, поэтому блокировок нет.
+ */
+
+#ifndef REPLYCACHE_H_
+#define REPLYCACHE_H_
+
+#include <stdint.h>
+
+#ifndef REPLYCACHE_SIZE
+#define REPLYCACHE_SIZE		8192	//!Двоичный снимок 4096 датчиков целиком (порция ~300 байт), текстовый - первые ~1700 датчиков
+#endif
+#define REPLYCACHE_ENTRIES	32
+
+//!Замеры кэша (команда cache)
+enum
+{
+	REPLYCACHE_HITS,
+	REPLYCACHE_MISSES,
+	REPLYCACHE_USED,	//!Занято байт в буфере
+	REPLYCACHE_STATS
+};
+
+const uint8_t *replycache_find(uint32_t version, uint8_t format, uint16_t first, uint16_t count, int *len);
+void replycache_store(uint32_t version, uint8_t format, uint16_t first, uint16_t count, const uint8_t *data, int len);
+void replycache_stats(uint32_t *out);
+
+#endif /* REPLYCACHE_H_ */
@@ -0,0 +1,77 @@
+/*
+ * ring.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Кольцевой буфер байт без блокировок: один писатель и один читатель (процесс и прерывание).
+ *      Индексы идут без сброса, позиция в буфере - индекс по маске, размер - степень двойки.
+ */
+
+#ifndef RING_H_
+#define RING_H_
+
+#include <stdint.h>
+
+typedef struct
+{
+	uint8_t *buf;
+	uint32_t mask;		//!Размер буфера - 1
+	uint32_t head;		//!Пишет только писатель
+	uint32_t tail;		//!Пишет только читатель
+} Ring_t;
+
+static inline void ring_init(Ring_t *ring, uint8_t *buf, uint32_t size)
+{
+	ring->buf = buf;
+	ring->mask = size - 1;
+	ring->head = 0;
+	ring->tail = 0;
+}
+
+static inline uint32_t ring_count(const Ring_t *ring)
+{
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+//! Байт в буфер. 0 - буфер полон
+static inline int ring_put(Ring_t *ring, uint8_t data)
+{
+	uint32_t head = ring->head;
+	if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) > ring->mask)
+		return 0;
+	ring->buf[head & ring->mask] = data;
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+//! Байт из буфера. 0 - буфер пуст
+static inline int ring_get(Ring_t *ring, uint8_t *data)
+{
+	uint32_t tail = ring->tail;
+	if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail)
+		return 0;
+	*data = ring->buf[tail & ring->mask];
+	__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+//! Запись сколько поместится, возвращает количество записанных байт. Индекс публикуется один раз на всю порцию
+static inline int ring_write(Ring_t *ring, const uint8_t *data, int len)
+{
+	uint32_t head = ring->head;
+	uint32_t space = ring->mask + 1 - (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+	int i = 0;
+	if ((uint32_t)len > space)
+	{
+		len = (int)space;
+	}
+	for (i = 0; i < len; i++)
+	{
+		ring->buf[(head + i) & ring->mask] = data[i];
+	}
+	__atomic_store_n(&ring->head, head + len, __ATOMIC_RELEASE);
+	return len;
+}
+
+#endif /* RING_H_ */
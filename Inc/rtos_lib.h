@@ -10,6 +10,8 @@
 #ifndef RTOS_LIB_H_
 #define RTOS_LIB_H_
 
+#include <stdint.h>
+
 #define THREDS_MAX 8
 #define TIMERS_MAX 4
 #define QUEUES_MAX 8
@@ -18,10 +20,17 @@
 void rtos_start(void);
 
 int rtos_thread_init(void(*thread_func)(const void*), int priority, int stackSize);
+int rtos_thread_init_arg(void(*thread_func)(const void*), const void *arg, int priority, int stackSize);
+void rtos_delay(long long time);
+uint32_t rtos_time_ms(void);
 
 int rtos_queue_init(int queueLength, int itemSize);
 int rtos_queue_send(int queue, const void* data, long long timeToWait);
+int rtos_queue_send_front(int queue, const void* data, long long timeToWait);
 int rtos_queue_receive(int queue, void *data, long long timeToWait);
+int rtos_queue_count(int queue);
+int rtos_queue_send_isr(int queue, const void* data);
+int rtos_queue_receive_isr(int queue, void *data);
 
 int rtos_timer_init(int periodic, void(*timerCallBack_func)(const void*));
 void rtos_timer_start(int timer, long long time);
@@ -3,12 +3,61 @@
  *
  *  Created on: Apr 23, 2024
  *      Author: Yury
+ *
+ *      Драйверы шин датчиков. Каждая шина (экземпляр драйвера) занимает свой диапазон номеров датчиков.
+ *      Опрос идёт пакетно: запуск преобразования на всех шинах сразу (шины преобразуют параллельно),
+ *      ожидание готовности, затем чтение порциями.
  */
 
 #ifndef SENSORS_H_
 #define SENSORS_H_
 
 #include <stdint.h>
-int8_t get_temperature(int index);
+
+//!Количество датчиков задаётся при сборке (-DSENSORS_MAX=4096), рабочее количество - командой sensors
+#ifndef SENSORS_MAX
+#define SENSORS_MAX		256
+#endif
+//!Таблица значений делится на шарды по строке кэша (значения int8_t), шард опрашивает один обработчик
+#define SENSORS_SHARD	32
+#define SENSORS_SHARDS	((SENSORS_MAX + SENSORS_SHARD - 1) / SENSORS_SHARD)
+#define SENSORS_SET_WORDS	((SENSORS_MAX + 31) / 32)	//!Размер набора датчиков (битовая карта по номерам) в словах
+
+#if SENSORS_MAX > 4096 || SENSORS_MAX % 8
+#error "SENSORS_MAX must be a multiple of 8 not greater than 4096"
+#endif
+
+//!Результат чтения датчика
+enum
+{
+	SENSOR_SKIP,	//!Датчик не входил в набор преобразования
+	SENSOR_OK,
+	SENSOR_FAIL
+};
+
+typedef struct SensorBus SensorBus_t;
+
+//!Драйвер шины. Номера датчиков - общие, first/count всегда лежат внутри bus->first..bus->first + bus->count - 1.
+//!set - битовая карта номеров датчиков: бит n % 32 слова n / 32, драйвер смотрит в ней только first..first + count - 1.
+//!Разные процессы опроса вызывают драйвер для непересекающихся диапазонов, выровненных по SENSORS_SHARD
+typedef struct
+{
+	int (*begin_conversion)(const SensorBus_t *bus, const uint32_t *set, int first, int count);
+	int (*is_ready)(const SensorBus_t *bus);
+	int (*read_batch)(const SensorBus_t *bus, int first, int count, int8_t *out, uint8_t *status);
+} SensorDriver_t;
+
+//!Экземпляр драйвера в таблице шин
+struct SensorBus
+{
+	const SensorDriver_t *driver;
+	int first;
+	int count;
+	void *ctx;	//!Состояние экземпляра драйвера
+};
+
+int sensors_begin(const uint32_t *set, int first, int count);
+int sensors_ready(int first, int count);
+void sensors_read(int first, int count, int8_t *out, uint8_t *status);
 
 #endif /* SENSORS_H_ */
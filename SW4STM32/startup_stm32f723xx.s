@@ -43,6 +43,15 @@ defined in linker script */
 .word  _sbss
 /* end address for the .bss section. defined in linker script */
 .word  _ebss
+/* start address for the initialization values of the .itcm section (hot code).
+defined in linker script */
+.word  _siitcm
+/* start/end address for the .itcm section. defined in linker script */
+.word  _sitcm
+.word  _eitcm
+/* start/end address for the .dtcm section (hot data). defined in linker script */
+.word  _sdtcm
+.word  _edtcm
 /* stack used for SystemInit_ExtMemCtl; always internal RAM used */
 
 /**
@@ -88,6 +97,34 @@ LoopFillZerobss:
   cmp  r2, r3
   bcc  FillZerobss
 
+/* Copy the hot code from flash to ITCM RAM */
+  movs  r1, #0
+  b  LoopCopyItcmInit
+
+CopyItcmInit:
+  ldr  r3, =_siitcm
+  ldr  r3, [r3, r1]
+  str  r3, [r0, r1]
+  adds  r1, r1, #4
+
+LoopCopyItcmInit:
+  ldr  r0, =_sitcm
+  ldr  r3, =_eitcm
+  adds  r2, r0, r1
+  cmp  r2, r3
+  bcc  CopyItcmInit
+  ldr  r2, =_sdtcm
+  b  LoopFillZeroDtcm
+/* Zero fill the DTCM section. */
+FillZeroDtcm:
+  movs  r3, #0
+  str  r3, [r2], #4
+
+LoopFillZeroDtcm:
+  ldr  r3, = _edtcm
+  cmp  r2, r3
+  bcc  FillZeroDtcm
+
 /* Call the clock system intitialization function.*/
   bl  SystemInit   
 /* Call static constructors */
@@ -0,0 +1,177 @@
+/*
+ * agg.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "agg.h"
+#include "mpuinit.h"
+
+#define WINDOW_MASK (AGG_WINDOW_MAX - 1)
+
+//!Монотонный дек позиций опросов (по модулю 256) в кольце на AGG_WINDOW_MAX элементов
+typedef struct
+{
+	uint8_t pos[AGG_WINDOW_MAX];
+	uint8_t first;
+	uint8_t count;
+} AggDeque_t;
+
+typedef struct
+{
+	int8_t values[AGG_WINDOW_MAX];	//!Последние AGG_WINDOW_MAX значений, индекс - позиция & WINDOW_MASK
+	AggDeque_t min;
+	AggDeque_t max;
+	int32_t sum;
+	uint32_t sumsq;
+} AggSensor_t;
+
+static AggSensor_t sensors[AGG_SENSORS];
+static uint32_t samples = 0;	//!Количество опросов
+static int window = 16;
+
+static inline int8_t deque_back_value(const AggSensor_t *s, const AggDeque_t *d)
+{
+	return s->values[d->pos[(d->first + d->count - 1) & WINDOW_MASK] & WINDOW_MASK];
+}
+
+static inline void deque_push(AggDeque_t *d, uint8_t pos)
+{
+	d->pos[(d->first + d->count) & WINDOW_MASK] = pos;
+	d->count++;
+}
+
+//! Удаление из начала дека позиций, вышедших из окна
+static inline void deque_expire(AggDeque_t *d, uint8_t pos)
+{
+	while (d->count && (uint8_t)(pos - d->pos[d->first]) >= window)
+	{
+		d->first = (d->first + 1) & WINDOW_MASK;
+		d->count--;
+	}
+}
+
+//! Добавление значения на позиции n. При окне AGG_WINDOW_MAX новое значение занимает ячейку выходящего из окна,
+//! поэтому сначала вычитается выходящее значение и из деков удаляются вышедшие позиции (их значения ещё на месте,
+//! а в деке остаётся не больше окна - 1 позиций), затем значение записывается и добавляется
+static inline void sensor_push(AggSensor_t *s, uint32_t n, int8_t x)
+{
+	uint8_t pos = (uint8_t)n;
+	if (n >= (uint32_t)window)
+	{
+		int8_t old = s->values[(n - window) & WINDOW_MASK];
+		s->sum -= old;
+		s->sumsq -= old * old;
+	}
+	deque_expire(&s->max, pos);
+	deque_expire(&s->min, pos);
+	s->values[n & WINDOW_MASK] = x;
+	s->sum += x;
+	s->sumsq += x * x;
+
+	while (s->max.count && deque_back_value(s, &s->max) <= x)
+		s->max.count--;
+	deque_push(&s->max, pos);
+
+	while (s->min.count && deque_back_value(s, &s->min) >= x)
+		s->min.count--;
+	deque_push(&s->min, pos);
+}
+
+//! Обновление на каждом опросе
+RAM_I_TCM void agg_update(const int8_t *values)
+{
+	int i = 0;
+	for (i = 0; i < AGG_SENSORS; i++)
+	{
+		sensor_push(&sensors[i], samples, values[i]);
+	}
+	samples++;
+}
+
+//! Смена окна: состояние пересобирается из сохранённых последних значений (один раз, O(окно))
+int agg_set_window(int newWindow)
+{
+	if (newWindow < 1 || newWindow > AGG_WINDOW_MAX)
+		return 0;
+	if (newWindow == window)
+		return 1;
+	window = newWindow;
+	uint32_t start = samples > (uint32_t)window ? samples - window : 0;
+	int i = 0;
+	for (i = 0; i < AGG_SENSORS; i++)
+	{
+		AggSensor_t *s = &sensors[i];
+		s->sum = 0;
+		s->sumsq = 0;
+		s->min.first = s->min.count = 0;
+		s->max.first = s->max.count = 0;
+		uint32_t n = 0;
+		for (n = start; n < samples; n++)
+		{
+			//!Значение вне окна не вычитается: суммы начинаются с первой позиции окна
+			int8_t x = s->values[n & WINDOW_MASK];
+			s->sum += x;
+			s->sumsq += x * x;
+			while (s->max.count && deque_back_value(s, &s->max) <= x)
+				s->max.count--;
+			deque_push(&s->max, (uint8_t)n);
+			while (s->min.count && deque_back_value(s, &s->min) >= x)
+				s->min.count--;
+			deque_push(&s->min, (uint8_t)n);
+		}
+	}
+	return 1;
+}
+
+int agg_window(void)
+{
+	return window;
+}
+
+static uint32_t isqrt(uint32_t x)
+{
+	uint32_t res = 0;
+	uint32_t bit = 1UL << 30;
+	while (bit > x)
+		bit >>= 2;
+	while (bit)
+	{
+		if (x >= res + bit)
+		{
+			x -= res + bit;
+			res = (res >> 1) + bit;
+		}
+		else
+		{
+			res >>= 1;
+		}
+		bit >>= 2;
+	}
+	return res;
+}
+
+//! Агрегаты датчиков first..first+count-1
+void agg_get(int first, int count, AggResult_t *out)
+{
+	uint32_t n = samples < (uint32_t)window ? samples : (uint32_t)window;
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		const AggSensor_t *s = &sensors[first + i];
+		if (!n)
+		{
+			out[i].min = out[i].max = 0;
+			out[i].mean = 0;
+			out[i].stddev = 0;
+			continue;
+		}
+		out[i].max = s->values[s->max.pos[s->max.first] & WINDOW_MASK];
+		out[i].min = s->values[s->min.pos[s->min.first] & WINDOW_MASK];
+		out[i].mean = (int16_t)((s->sum * (1 << AGG_FRAC_BITS)) / (int32_t)n);
+		//!Дисперсия в Q16: (n * sum(x^2) - sum(x)^2) / n^2
+		uint64_t var = ((uint64_t)((int64_t)n * s->sumsq - (int64_t)s->sum * s->sum) << (2 * AGG_FRAC_BITS)) / ((uint64_t)n * n);
+		out[i].stddev = (uint16_t)isqrt((uint32_t)var);
+	}
+}
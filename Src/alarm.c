@@ -0,0 +1,93 @@
+/*
+ * alarm.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "alarm.h"
+#include "mpuinit.h"
+
+typedef struct
+{
+	int8_t low;
+	int8_t high;
+	uint8_t hysteresis;
+	uint8_t enabled;
+	uint8_t state;
+} AlarmSensor_t;
+
+static AlarmSensor_t sensors[ALARM_SENSORS];
+
+//! Пороги датчика: выше high - ALARM_HIGH, ниже low - ALARM_LOW. Возврат в норму после ухода от порога на hysteresis
+int alarm_set(int sensor, int low, int high, int hysteresis)
+{
+	if (sensor < 0 || sensor >= ALARM_SENSORS || low < -128 || high > 127 || low > high ||
+			hysteresis < 0 || hysteresis > high - low)
+		return 0;
+	AlarmSensor_t *s = &sensors[sensor];
+	s->enabled = 0;
+	s->low = (int8_t)low;
+	s->high = (int8_t)high;
+	s->hysteresis = (uint8_t)hysteresis;
+	s->state = ALARM_NORMAL;
+	s->enabled = 1;
+	return 1;
+}
+
+//! Проверка снимка. Возвращает количество переходов состояния, записанных в events
+RAM_I_TCM int alarm_check(const int8_t *values, AlarmEvent_t *events)
+{
+	int count = 0;
+	int i = 0;
+	for (i = 0; i < ALARM_SENSORS && count < ALARM_EVENTS_MAX; i++)
+	{
+		AlarmSensor_t *s = &sensors[i];
+		if (!s->enabled)
+			continue;
+		int x = values[i];
+		uint8_t state = s->state;
+		switch (state)
+		{
+			case ALARM_NORMAL:
+				if (x > s->high)
+					state = ALARM_HIGH;
+				else if (x < s->low)
+					state = ALARM_LOW;
+				break;
+			case ALARM_HIGH:
+				if (x < s->low)
+					state = ALARM_LOW;
+				else if (x <= s->high - s->hysteresis)
+					state = ALARM_NORMAL;
+				break;
+			case ALARM_LOW:
+				if (x > s->high)
+					state = ALARM_HIGH;
+				else if (x >= s->low + s->hysteresis)
+					state = ALARM_NORMAL;
+				break;
+		}
+		if (state != s->state)
+		{
+			events[count].prev = s->state;
+			s->state = state;
+			events[count].sensor = (uint16_t)i;
+			events[count].state = state;
+			events[count].value = (int8_t)x;
+			count++;
+		}
+	}
+	return count;
+}
+
+//! Отмена перехода, о котором сервер не узнал (кадр тревоги не поставлен в очередь): датчик возвращается
+//! в прежнее состояние, и переход, если порог всё ещё пройден, найдётся на следующем опросе заново
+void alarm_revert(const AlarmEvent_t *event)
+{
+	AlarmSensor_t *s = &sensors[event->sensor];
+	if (s->state == event->state)
+	{
+		s->state = event->prev;
+	}
+}
@@ -0,0 +1,184 @@
+/*
+ * analog.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "analog.h"
+#include "mpuinit.h"
+
+#define HALF_LENGTH		(ANALOG_CHANNELS * ANALOG_OVERSAMPLE)
+#define NTC_T_MIN		-40	//!Температура первой точки таблицы, °C
+#define NTC_T_STEP		5
+#define NTC_POINTS		34
+
+//!Входы ADC1: PA4, PA6, PC1, PC2, PC3
+static const uint8_t channels[ANALOG_CHANNELS] = { 4, 6, 11, 12, 13 };
+
+//!Код 12-битного АЦП для -40..125 °C с шагом 5 °C, по убыванию. За пределами таблицы - обрыв или замыкание
+static const uint16_t ntcTable[NTC_POINTS] =
+{
+		3996, 3955, 3900, 3830, 3740, 3629, 3495, 3337, 3156, 2955, 2738, 2510,
+		2278, 2048, 1825, 1614, 1419, 1241, 1081, 940, 815, 707, 613, 532,
+		462, 401, 350, 305, 267, 234, 206, 181, 160, 142
+};
+
+//!Двойной буфер DMA: [0..HALF_LENGTH) и [HALF_LENGTH..2 * HALF_LENGTH), по каналам внутри прохода
+static uint16_t adcBuffer[2 * HALF_LENGTH] RAM_DMA;
+static volatile int8_t values[ANALOG_CHANNELS];
+static volatile uint8_t valid[ANALOG_CHANNELS];
+
+#ifndef STM32_BUILD
+//!Записанная трасса кодов по проходам: комната, нагрев 20..30 °C, холод -5 °C, обрыв датчика, одиночный выброс
+static const uint16_t trace[][ANALOG_CHANNELS] =
+{
+		{ 2184, 2276, 3337, 4095, 2046 },
+		{ 2182, 2266, 3338, 4095, 2046 },
+		{ 2184, 2249, 3334, 4095, 2050 },
+		{ 2183, 2230, 3334, 4095, 2049 },
+		{ 2185, 2215, 3335, 4095, 2046 },
+		{ 2186, 2203, 3334, 4095, 2050 },
+		{ 2182, 2186, 3339, 4095, 2050 },
+		{ 2182, 2174, 3338, 4095, 2049 },
+		{ 2182, 2156, 3334, 4095, 2050 },
+		{ 2188, 2141, 3336, 4095, 2049 },
+		{ 2183, 2130, 3334, 4095, 2050 },
+		{ 2184, 2115, 3340, 4095, 2047 },
+		{ 2182, 2100, 3338, 4095, 2047 },
+		{ 2184, 2081, 3338, 4095,  600 },
+		{ 2186, 2067, 3338, 4095, 2047 },
+		{ 2185, 2057, 3338, 4095, 2049 },
+		{ 2188, 2039, 3337, 4095, 2050 },
+		{ 2185, 2025, 3336, 4095, 2047 },
+		{ 2188, 2009, 3339, 4095, 2047 },
+		{ 2182, 1997, 3336, 4095, 2050 },
+		{ 2185, 1981, 3339, 4095, 2049 },
+		{ 2184, 1968, 3334, 4095, 2046 },
+		{ 2186, 1953, 3335, 4095, 2048 },
+		{ 2183, 1938, 3337, 4095, 2046 },
+		{ 2187, 1921, 3340, 4095, 2050 },
+		{ 2186, 1913, 3340, 4095, 2048 },
+		{ 2184, 1897, 3336, 4095, 2050 },
+		{ 2185, 1882, 3340, 4095, 2049 },
+		{ 2182, 1870, 3334, 4095, 2048 },
+		{ 2185, 1855, 3339, 4095, 2046 },
+		{ 2182, 1841, 3339, 4095, 2048 },
+		{ 2187, 1826, 3339, 4095, 2049 }
+};
+static int tracePos = 0;
+static int traceHalf = 0;
+static uint8_t consumed = 0;	//!Каналы, уже прочитанные из текущей половины
+#endif
+
+//! Код АЦП -> температура, °C, линейная интерполяция по таблице. Возвращает 0 вне таблицы
+static int ntc_convert(uint32_t code, int8_t *temp)
+{
+	if (code > ntcTable[0] || code < ntcTable[NTC_POINTS - 1])
+		return 0;
+	int i = 0;
+	while (i < NTC_POINTS - 2 && code < ntcTable[i + 1])
+	{
+		i++;
+	}
+	int span = ntcTable[i] - ntcTable[i + 1];
+	int t = (NTC_T_MIN + NTC_T_STEP * i) * span + NTC_T_STEP * (int)(ntcTable[i] - code);
+	*temp = (int8_t)((t >= 0 ? t + span / 2 : t - span / 2) / span);
+	return 1;
+}
+
+//! Прерывание DMA (половина или конец буфера): усреднение проходов и перевод в температуру по всем каналам
+RAM_I_TCM static void adc_complete(int half)
+{
+	const uint16_t *samples = &adcBuffer[half ? HALF_LENGTH : 0];
+	uint32_t sum[ANALOG_CHANNELS] = { 0 };
+	int i = 0, ch = 0;
+	for (i = 0; i < ANALOG_OVERSAMPLE; i++)
+	{
+		for (ch = 0; ch < ANALOG_CHANNELS; ch++)
+		{
+			sum[ch] += *samples++;
+		}
+	}
+	for (ch = 0; ch < ANALOG_CHANNELS; ch++)
+	{
+		int8_t temp = 0;
+		valid[ch] = (uint8_t)ntc_convert((sum[ch] + ANALOG_OVERSAMPLE / 2) / ANALOG_OVERSAMPLE, &temp);
+		values[ch] = temp;
+	}
+}
+
+#ifndef STM32_BUILD
+//! Имитация DMA: следующие ANALOG_OVERSAMPLE проходов трассы в очередную половину буфера и её обработка
+static void trace_step(void)
+{
+	uint16_t *half = &adcBuffer[traceHalf ? HALF_LENGTH : 0];
+	int i = 0, ch = 0;
+	for (i = 0; i < ANALOG_OVERSAMPLE; i++)
+	{
+		for (ch = 0; ch < ANALOG_CHANNELS; ch++)
+		{
+			*half++ = trace[tracePos][ch];
+		}
+		tracePos = (tracePos + 1) % (int)(sizeof(trace) / sizeof(trace[0]));
+	}
+	adc_complete(traceHalf);
+	traceHalf ^= 1;
+	consumed = 0;
+}
+#endif
+
+int analog_init(void)
+{
+#ifdef STM32_BUILD
+	return adc_scan_init(channels, ANALOG_CHANNELS, adcBuffer, 2 * HALF_LENGTH, ANALOG_RATE_HZ, adc_complete);
+#else
+	(void)channels;
+	trace_step();
+	return 1;
+#endif
+}
+
+//! Последняя температура канала. Возвращает 0, если преобразований ещё не было или датчик вне таблицы
+int analog_read(int channel, int8_t *value)
+{
+	if (channel < 0 || channel >= ANALOG_CHANNELS)
+		return 0;
+#ifndef STM32_BUILD
+	//!На хосте трасса продвигается, когда канал читается повторно из той же половины
+	if (consumed & (1 << channel))
+	{
+		trace_step();
+	}
+	consumed |= (uint8_t)(1 << channel);
+#endif
+	*value = values[channel];
+	return valid[channel];
+}
+
+static int analog_begin(const SensorBus_t *bus, const uint32_t *set, int first, int count)
+{
+	(void)bus;
+	(void)set;
+	(void)first;
+	(void)count;
+	return 1;
+}
+
+static int analog_ready(const SensorBus_t *bus)
+{
+	(void)bus;
+	return 1;
+}
+
+static int analog_batch(const SensorBus_t *bus, int first, int count, int8_t *out, uint8_t *status)
+{
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		status[i] = analog_read(first + i - bus->first, &out[i]) ? SENSOR_OK : SENSOR_FAIL;
+	}
+	return 1;
+}
+
+const SensorDriver_t analog_driver = { analog_begin, analog_ready, analog_batch };
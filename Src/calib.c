@@ -0,0 +1,318 @@
+/*
+ * calib.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "calib.h"
+#include "codec.h"
+#include "mpuinit.h"
+#include <string.h>
+
+#if defined(STM32_BUILD) && defined(__ARM_FEATURE_DSP)
+#include "stm32f7xx.h"
+#define CALIB_SIMD
+#endif
+
+#define CALIB_MAGIC		0x314C4143	//!"CAL1"
+#define CALIB_COPIES	2	//!Копии пишутся по очереди: пока пишется одна, другая остаётся целой
+#define CALIB_COPY_SIZE	(FLASHLOG_SECTOR_SIZE / CALIB_COPIES)	//!Стирается блоками QSPI_ERASE_SIZE, не задевая другую копию
+
+typedef struct
+{
+	uint8_t count;	//!Точек в кривой, меньше 2 - кривая не действует
+	int8_t x[CALIB_POINTS];	//!По возрастанию
+	int8_t y[CALIB_POINTS];
+} CalibCurve_t;
+
+//!Образ таблицы во FLASH: страница заголовка, затем CalibTable_t
+typedef struct
+{
+	int8_t gain[CALIB_SENSORS];
+	int8_t offset[CALIB_SENSORS];
+	uint8_t curve[CALIB_SENSORS];
+	CalibCurve_t curves[CALIB_CURVES];
+} CalibTable_t;
+
+typedef struct
+{
+	uint32_t magic;
+	uint16_t sensors;
+	uint16_t crc;	//!CRC-16 данных таблицы
+	uint32_t length;
+	uint32_t sequence;	//!Номер записи, действует копия с большим. У копии до введения номеров - 0xFFFFFFFF (стёртая FLASH)
+} CalibHeader_t;
+
+_Static_assert(QSPI_PAGE_SIZE + sizeof(CalibTable_t) <= CALIB_COPY_SIZE, "calibration table must fit into one copy");
+_Static_assert(CALIB_COPY_SIZE % QSPI_ERASE_SIZE == 0, "calibration copy must be erasable separately");
+
+//!Таблица, по которой идёт проход калибровки (действующая или замера calib_bench)
+typedef struct
+{
+	const int8_t *gain;
+	const int8_t *offset;
+	const uint8_t *curve;
+	const CalibCurve_t *curves;
+} CalibView_t;
+
+static CalibTable_t table RAM_EXT;
+static const CalibView_t view = { table.gain, table.offset, table.curve, table.curves };
+static int ready = 0;
+static int active = -1;			//!Копия, из которой загружена или в которую последней записана таблица, -1 - нет
+static uint32_t sequence = 0;	//!Номер записи действующей копии
+
+static uint32_t copy_addr(int copy)
+{
+	return CALIB_FLASH_ADDR + copy * CALIB_COPY_SIZE;
+}
+
+//! Заголовок копии copy. 0 - копии нет или она другого формата
+static int header_read(int copy, CalibHeader_t *header)
+{
+	return qspi_read(copy_addr(copy), header, sizeof(*header)) && header->magic == CALIB_MAGIC &&
+			header->sensors == CALIB_SENSORS && header->length == sizeof(table);
+}
+
+//! Загрузка таблицы из FLASH при старте (после qspi_init): самая новая целая копия, если запись новой оборвал сброс -
+//! предыдущая. Без сохранённой таблицы датчики не калибруются
+int calib_load(void)
+{
+	CalibHeader_t header[CALIB_COPIES];
+	int valid[CALIB_COPIES];
+	int i = 0;
+	ready = ram_ext_init();
+	if (!ready)
+		return 0;
+	for (i = 0; i < CALIB_COPIES; i++)
+	{
+		valid[i] = header_read(i, &header[i]);
+	}
+	//!Сначала более новая копия (номера сравниваются с переполнением)
+	int newest = valid[1] && (!valid[0] || (int32_t)(header[1].sequence - header[0].sequence) > 0);
+	for (i = 0; i < CALIB_COPIES; i++)
+	{
+		int copy = i ? !newest : newest;
+		if (valid[copy] && qspi_read(copy_addr(copy) + QSPI_PAGE_SIZE, &table, sizeof(table)) &&
+				codec_crc16(0xFFFF, (const uint8_t *)&table, sizeof(table)) == header[copy].crc)
+		{
+			active = copy;
+			sequence = header[copy].sequence;
+			return 1;
+		}
+	}
+	memset(&table, 0, sizeof(table));
+	active = -1;
+	sequence = 0;
+	return 0;
+}
+
+//! Запись таблицы во FLASH. Вызывается процессом журнала через flashlog_locked: QSPI занят на всё время записи,
+//! чтение history ждёт. Таблица может меняться во время записи: CRC считается по записанным копиям страниц,
+//! заголовок пишется последним. Пишется копия, не содержащая действующую таблицу: до записи заголовка новой копии
+//! при сбросе загрузится прежняя. Возвращает 0, если запись не удалась (действующей остаётся прежняя копия)
+int calib_save(void)
+{
+	uint8_t page[QSPI_PAGE_SIZE];
+	CalibHeader_t header = { CALIB_MAGIC, CALIB_SENSORS, 0xFFFF, sizeof(table), sequence + 1 };
+	int copy = active == 0;
+	uint32_t base = copy_addr(copy);
+	uint32_t addr = 0;
+	uint32_t done = 0;
+	if (!ready)
+		return 0;
+	for (addr = 0; addr < QSPI_PAGE_SIZE + sizeof(table); addr += QSPI_ERASE_SIZE)
+	{
+		if (!qspi_erase(base + addr))
+			return 0;
+	}
+	for (done = 0; done < sizeof(table); done += QSPI_PAGE_SIZE)
+	{
+		uint32_t n = sizeof(table) - done < QSPI_PAGE_SIZE ? sizeof(table) - done : QSPI_PAGE_SIZE;
+		memcpy(page, (const uint8_t *)&table + done, n);
+		header.crc = codec_crc16(header.crc, page, n);
+		if (!qspi_write(base + QSPI_PAGE_SIZE + done, page, n))
+			return 0;
+	}
+	if (!qspi_write(base, &header, sizeof(header)))
+		return 0;
+	active = copy;
+	sequence = header.sequence;
+	return 1;
+}
+
+//! Калибровка датчика: gain в 1/256 (-128..127), offset в 1/4 °C (-128..127), curve 0..CALIB_CURVES
+int calib_set(int sensor, int gain, int offset, int curve)
+{
+	if (!ready || sensor < 0 || sensor >= CALIB_SENSORS || gain < -128 || gain > 127 ||
+			offset < -128 || offset > 127 || curve < 0 || curve > CALIB_CURVES)
+		return 0;
+	table.gain[sensor] = (int8_t)gain;
+	table.offset[sensor] = (int8_t)offset;
+	table.curve[sensor] = (uint8_t)curve;
+	return 1;
+}
+
+//! Точка кривой: сырое значение x -> y. Точки задаются по возрастанию x, точка point продлевает кривую до point + 1 точек
+int calib_point(int curve, int point, int x, int y)
+{
+	if (!ready || curve < 1 || curve > CALIB_CURVES || point < 0 || point >= CALIB_POINTS ||
+			x < -128 || x > 127 || y < -128 || y > 127)
+		return 0;
+	CalibCurve_t *c = &table.curves[curve - 1];
+	if (point > c->count || (point > 0 && x <= c->x[point - 1]))
+		return 0;
+	c->x[point] = (int8_t)x;
+	c->y[point] = (int8_t)y;
+	c->count = (uint8_t)(point + 1);
+	return 1;
+}
+
+//! Кусочно-линейная кривая, за крайними точками - значение крайней точки
+static int curve_apply(const CalibCurve_t *c, int x)
+{
+	if (c->count < 2)
+		return x;
+	if (x <= c->x[0])
+		return c->y[0];
+	int i = 1;
+	while (i < c->count - 1 && x > c->x[i])
+	{
+		i++;
+	}
+	if (x >= c->x[i])
+		return c->y[i];
+	int dx = c->x[i] - c->x[i - 1];
+	int dy = (c->y[i] - c->y[i - 1]) * (x - c->x[i - 1]);
+	return c->y[i - 1] + (dy >= 0 ? dy + dx / 2 : dy - dx / 2) / dx;
+}
+
+static inline uint32_t load4(const void *p)
+{
+	uint32_t word;
+	memcpy(&word, p, sizeof(word));
+	return word;
+}
+
+static inline void store4(void *p, uint32_t word)
+{
+	memcpy(p, &word, sizeof(word));
+}
+
+//! Коэффициент и смещение четырёх датчиков по одному: в 1/256 °C x * (256 + gain) + offset * 64,
+//! округление к ближайшему, насыщение до int8_t
+static inline uint32_t scale_scalar(uint32_t x, uint32_t gain, uint32_t offset)
+{
+	uint32_t out = 0;
+	int j = 0;
+	for (j = 0; j < 32; j += 8)
+	{
+		int32_t y = (int8_t)(x >> j) * ((1 << CALIB_GAIN_FRAC) + (int8_t)(gain >> j)) +
+				(int8_t)(offset >> j) * (1 << (CALIB_GAIN_FRAC - CALIB_OFFSET_FRAC));
+		y = (y + (1 << (CALIB_GAIN_FRAC - 1))) >> CALIB_GAIN_FRAC;
+		out |= (uint32_t)(uint8_t)(y > 127 ? 127 : y < -128 ? -128 : y) << j;
+	}
+	return out;
+}
+
+#ifdef CALIB_SIMD
+//! То же словом на четыре датчика: SXTB16 раскладывает чётные и нечётные байты по полусловам, PKHBT/PKHTB собирают
+//! пары (x, offset) и (256 + gain, 64), и один SMLAD на датчик считает x * (256 + gain) + offset * 64 + 128.
+//! Результат совпадает со скалярной версией до бита
+static inline uint32_t scale_simd(uint32_t x, uint32_t gain, uint32_t offset)
+{
+	const uint32_t unit = 0x00010001UL << CALIB_GAIN_FRAC;
+	const uint32_t step = (1UL << (CALIB_GAIN_FRAC - CALIB_OFFSET_FRAC)) << 16;
+	const int32_t round = 1 << (CALIB_GAIN_FRAC - 1);
+	uint32_t xe = __SXTB16(x), xo = __SXTB16(__ROR(x, 8));
+	uint32_t oe = __SXTB16(offset), oo = __SXTB16(__ROR(offset, 8));
+	uint32_t ge = __SADD16(__SXTB16(gain), unit), go = __SADD16(__SXTB16(__ROR(gain, 8)), unit);
+	int32_t y0 = (int32_t)__SMLAD(__PKHBT(xe, oe, 16), __PKHBT(ge, step, 0), round) >> CALIB_GAIN_FRAC;
+	int32_t y1 = (int32_t)__SMLAD(__PKHBT(xo, oo, 16), __PKHBT(go, step, 0), round) >> CALIB_GAIN_FRAC;
+	int32_t y2 = (int32_t)__SMLAD(__PKHTB(oe, xe, 16), __PKHTB(step, ge, 16), round) >> CALIB_GAIN_FRAC;
+	int32_t y3 = (int32_t)__SMLAD(__PKHTB(oo, xo, 16), __PKHTB(step, go, 16), round) >> CALIB_GAIN_FRAC;
+	return (uint32_t)(uint8_t)__SSAT(y0, 8) | (uint32_t)(uint8_t)__SSAT(y1, 8) << 8 |
+			(uint32_t)(uint8_t)__SSAT(y2, 8) << 16 | (uint32_t)(uint8_t)__SSAT(y3, 8) << 24;
+}
+#endif
+
+//! Проход по снимку словами по четыре датчика: некалиброванные четвёрки копируются, у четвёрок с кривыми сначала
+//! кривые (поэлементно, только у датчиков с кривой), затем коэффициент и смещение всей четвёрки сразу (simd)
+static inline int apply(const CalibView_t *t, const int8_t *raw, int8_t *out, int count, int simd)
+{
+	uint32_t changed = 0;
+	int i = 0, j = 0;
+	for (i = 0; i < count; i += 4)
+	{
+		uint32_t gain = load4(&t->gain[i]);
+		uint32_t offset = load4(&t->offset[i]);
+		uint32_t x = load4(&raw[i]);
+		uint32_t y = x;
+		if (load4(&t->curve[i]))
+		{
+			int8_t curved[4];
+			for (j = 0; j < 4; j++)
+			{
+				uint8_t c = t->curve[i + j];
+				curved[j] = c ? (int8_t)curve_apply(&t->curves[c - 1], raw[i + j]) : raw[i + j];
+			}
+			x = y = load4(curved);
+		}
+		if (gain | offset)
+		{
+#ifdef CALIB_SIMD
+			y = simd ? scale_simd(x, gain, offset) : scale_scalar(x, gain, offset);
+#else
+			(void)simd;
+			y = scale_scalar(x, gain, offset);
+#endif
+		}
+		changed |= load4(&out[i]) ^ y;
+		store4(&out[i], y);
+	}
+	return changed != 0;
+}
+
+//! Калибровка снимка: out[i] = calib(raw[i]) для count датчиков (count кратно 4 или буферы дополнены до кратного 4).
+//! Четвёрки некалиброванных датчиков копируются одним словом. Возвращает 1, если out изменился
+RAM_I_TCM int calib_apply(const int8_t *raw, int8_t *out, int count)
+{
+	if (!ready)
+	{
+		int changed = memcmp(out, raw, count) != 0;
+		memcpy(out, raw, count);
+		return changed;
+	}
+#ifdef CALIB_SIMD
+	return apply(&view, raw, out, count, 1);
+#else
+	return apply(&view, raw, out, count, 0);
+#endif
+}
+
+//! Замер: калибровка CALIB_BENCH датчиков с коэффициентом и смещением у каждого (без кривых), в тактах,
+//! SIMD (0 без DSP) и скалярная версия. Таблица замера своя, действующая не меняется
+void calib_bench(uint32_t *simdCycles, uint32_t *scalarCycles)
+{
+	static int8_t benchGain[CALIB_BENCH] CACHE_ALIGNED, benchOffset[CALIB_BENCH] CACHE_ALIGNED;
+	static uint8_t benchCurve[CALIB_BENCH] CACHE_ALIGNED;
+	static int8_t benchRaw[CALIB_BENCH] CACHE_ALIGNED, benchOut[CALIB_BENCH] CACHE_ALIGNED;
+	const CalibView_t bench = { benchGain, benchOffset, benchCurve, NULL };
+	int i = 0;
+	for (i = 0; i < CALIB_BENCH; i++)
+	{
+		benchGain[i] = (int8_t)(i * 13 - 100);
+		benchOffset[i] = (int8_t)(i * 7 - 60);
+		benchCurve[i] = 0;
+		benchRaw[i] = (int8_t)(i * 37);
+	}
+	uint32_t start = cycle_counter_get();
+	apply(&bench, benchRaw, benchOut, CALIB_BENCH, 0);
+	*scalarCycles = cycle_counter_get() - start;
+	*simdCycles = 0;
+#ifdef CALIB_SIMD
+	start = cycle_counter_get();
+	apply(&bench, benchRaw, benchOut, CALIB_BENCH, 1);
+	*simdCycles = cycle_counter_get() - start;
+#endif
+}
@@ -0,0 +1,530 @@
+/*
+ * codec.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "codec.h"
+#include "mpuinit.h"
+#include <string.h>
+
+//!Запись полубайтов: старший полубайт байта заполняется первым
+typedef struct
+{
+	uint8_t *out;
+	int pos; //!Номер полубайта
+} NibbleWriter_t;
+
+static inline void put_nibble(NibbleWriter_t *w, uint8_t nibble)
+{
+	if (w->pos & 1)
+	{
+		w->out[w->pos >> 1] |= nibble;
+	}
+	else
+	{
+		w->out[w->pos >> 1] = (uint8_t)(nibble << 4);
+	}
+	w->pos++;
+}
+
+static inline uint8_t get_nibble(const uint8_t *in, int pos)
+{
+	return (pos & 1) ? (in[pos >> 1] & 0x0F) : (in[pos >> 1] >> 4);
+}
+
+//! Кодирование снимка cur относительно prev. Возвращает длину в байтах
+RAM_I_TCM int codec_delta_encode(const int8_t *cur, const int8_t *prev, int count, uint8_t *out)
+{
+	NibbleWriter_t w = { out, 0 };
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		int delta = cur[i] - prev[i];
+		if (delta >= -7 && delta <= 7)
+		{
+			put_nibble(&w, (uint8_t)(delta & 0x0F));
+		}
+		else
+		{
+			put_nibble(&w, CODEC_NIBBLE_ESCAPE);
+			put_nibble(&w, (uint8_t)cur[i] >> 4);
+			put_nibble(&w, (uint8_t)cur[i] & 0x0F);
+		}
+	}
+	return (w.pos + 1) >> 1;
+}
+
+//! Обратное преобразование. Возвращает 1 если данных хватило на count значений
+int codec_delta_decode(const uint8_t *in, int len, const int8_t *prev, int count, int8_t *cur)
+{
+	int pos = 0;
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		if (pos >= len * 2)
+			return 0;
+		uint8_t nibble = get_nibble(in, pos++);
+		if (nibble == CODEC_NIBBLE_ESCAPE)
+		{
+			if (pos + 2 > len * 2)
+				return 0;
+			uint8_t hi = get_nibble(in, pos++);
+			cur[i] = (int8_t)((hi << 4) | get_nibble(in, pos++));
+		}
+		else
+		{
+			//!Знаковое расширение полубайта
+			cur[i] = (int8_t)(prev[i] + (int8_t)(nibble << 4) / 16);
+		}
+	}
+	return 1;
+}
+
+//! Длина результата codec_delta_encode без кодирования
+RAM_I_TCM int codec_delta_size(const int8_t *cur, const int8_t *prev, int count)
+{
+	int nibbles = 0;
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		int delta = cur[i] - prev[i];
+		nibbles += (delta >= -7 && delta <= 7) ? 1 : 3;
+	}
+	return (nibbles + 1) >> 1;
+}
+
+//! Канонические коды символов по длинам. 0 - длины не задают префиксный код (неравенство Крафта) или у escape нет кода
+static int huff_codes(const uint8_t *lengths, uint16_t *codes)
+{
+	uint16_t count[CODEC_HUFF_MAX_LEN + 1], next[CODEC_HUFF_MAX_LEN + 1];
+	uint32_t kraft = 0;
+	uint16_t code = 0;
+	int s = 0, l = 0;
+	memset(count, 0, sizeof(count));
+	for (s = 0; s < CODEC_HUFF_SYMBOLS; s++)
+	{
+		if (lengths[s] > CODEC_HUFF_MAX_LEN)
+			return 0;
+		count[lengths[s]]++;
+		if (lengths[s])
+		{
+			kraft += 1UL << (CODEC_HUFF_MAX_LEN - lengths[s]);
+		}
+	}
+	if (!lengths[CODEC_HUFF_ESCAPE] || kraft > 1UL << CODEC_HUFF_MAX_LEN)
+		return 0;
+	count[0] = 0;
+	for (l = 1; l <= CODEC_HUFF_MAX_LEN; l++)
+	{
+		code = (uint16_t)((code + count[l - 1]) << 1);
+		next[l] = code;
+	}
+	for (s = 0; s < CODEC_HUFF_SYMBOLS; s++)
+	{
+		if (lengths[s])
+		{
+			codes[s] = next[lengths[s]]++;
+		}
+	}
+	return 1;
+}
+
+//! Таблица кодера по длинам кодов CODEC_HUFF_SYMBOLS символов. 0 - длины не задают код
+int codec_huff_table(const uint8_t *lengths, HuffTable_t *table)
+{
+	if (!huff_codes(lengths, table->code))
+		return 0;
+	memcpy(table->len, lengths, CODEC_HUFF_SYMBOLS);
+	return 1;
+}
+
+//! Кодирование снимка cur относительно prev: код символа берётся из таблицы по разности и дописывается
+//! в 32-битный накопитель, полные байты уходят в out. Возвращает длину в байтах, 0 - результат длиннее max
+RAM_I_TCM int codec_huff_encode(const HuffTable_t *table, const int8_t *cur, const int8_t *prev, int count, uint8_t *out, int max)
+{
+	uint32_t acc = 0;
+	int bits = 0, len = 0;
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		int sym = cur[i] - prev[i] + CODEC_HUFF_DELTA_MAX;
+		if (sym < 0 || sym >= CODEC_HUFF_ESCAPE || !table->len[sym])
+		{
+			acc = (acc << table->len[CODEC_HUFF_ESCAPE] | table->code[CODEC_HUFF_ESCAPE]) << 8 | (uint8_t)cur[i];
+			bits += table->len[CODEC_HUFF_ESCAPE] + 8;
+		}
+		else
+		{
+			acc = acc << table->len[sym] | table->code[sym];
+			bits += table->len[sym];
+		}
+		//!До записи в накопителе меньше 8 бит, после - не больше 7 + 12 + 8
+		while (bits >= 8)
+		{
+			if (len == max)
+				return 0;
+			bits -= 8;
+			out[len++] = (uint8_t)(acc >> bits);
+		}
+	}
+	if (bits)
+	{
+		if (len == max)
+			return 0;
+		out[len++] = (uint8_t)(acc << (8 - bits));
+	}
+	return len;
+}
+
+//! Длины кодов по частотам символов (строит хост по записанным разностям). Символы с нулевой частотой остаются
+//! без кода, escape получает код всегда. Если дерево глубже CODEC_HUFF_MAX_LEN, частоты сглаживаются и дерево
+//! строится заново
+void codec_huff_build(const uint32_t *counts, uint8_t *lengths)
+{
+	uint32_t scaled[CODEC_HUFF_SYMBOLS];
+	int s = 0;
+	for (s = 0; s < CODEC_HUFF_SYMBOLS; s++)
+	{
+		scaled[s] = counts[s];
+	}
+	if (!scaled[CODEC_HUFF_ESCAPE])
+	{
+		scaled[CODEC_HUFF_ESCAPE] = 1;
+	}
+	while (1)
+	{
+		uint32_t weight[CODEC_HUFF_SYMBOLS * 2];
+		uint8_t parent[CODEC_HUFF_SYMBOLS * 2], active[CODEC_HUFF_SYMBOLS * 2];
+		int nodes = CODEC_HUFF_SYMBOLS, deepest = 0;
+		int a = -1, b = -1, n = 0;
+		for (s = 0; s < CODEC_HUFF_SYMBOLS; s++)
+		{
+			weight[s] = scaled[s];
+			active[s] = scaled[s] != 0;
+		}
+		//!Слияние двух самых лёгких узлов, пока не останется корень (a)
+		while (1)
+		{
+			a = -1;
+			b = -1;
+			for (n = 0; n < nodes; n++)
+			{
+				if (!active[n])
+					continue;
+				if (a < 0 || weight[n] < weight[a])
+				{
+					b = a;
+					a = n;
+				}
+				else if (b < 0 || weight[n] < weight[b])
+				{
+					b = n;
+				}
+			}
+			if (b < 0)
+				break;
+			weight[nodes] = weight[a] + weight[b];
+			active[nodes] = 1;
+			active[a] = 0;
+			active[b] = 0;
+			parent[a] = (uint8_t)nodes;
+			parent[b] = (uint8_t)nodes;
+			nodes++;
+		}
+		for (s = 0; s < CODEC_HUFF_SYMBOLS; s++)
+		{
+			int depth = 0;
+			if (scaled[s])
+			{
+				for (n = s; n != a; n = parent[n])
+				{
+					depth++;
+				}
+				//!Единственный символ - код из одного бита
+				if (!depth)
+				{
+					depth = 1;
+				}
+			}
+			lengths[s] = (uint8_t)depth;
+			if (depth > deepest)
+			{
+				deepest = depth;
+			}
+		}
+		if (deepest <= CODEC_HUFF_MAX_LEN)
+			return;
+		for (s = 0; s < CODEC_HUFF_SYMBOLS; s++)
+		{
+			if (scaled[s])
+			{
+				scaled[s] = (scaled[s] >> 1) | 1;
+			}
+		}
+	}
+}
+
+//! Таблица декодера (хост): каждый код занимает 2^(CODEC_HUFF_MAX_LEN - длина) записей. 0 - длины не задают код
+int codec_huff_decoder(const uint8_t *lengths, HuffDecoder_t *decoder)
+{
+	uint16_t codes[CODEC_HUFF_SYMBOLS];
+	int s = 0;
+	if (!huff_codes(lengths, codes))
+		return 0;
+	memset(decoder->lut, 0, sizeof(decoder->lut));
+	for (s = 0; s < CODEC_HUFF_SYMBOLS; s++)
+	{
+		if (lengths[s])
+		{
+			int shift = CODEC_HUFF_MAX_LEN - lengths[s];
+			uint32_t first = (uint32_t)codes[s] << shift;
+			uint32_t j = 0;
+			for (j = 0; j < (1UL << shift); j++)
+			{
+				decoder->lut[first + j] = (uint16_t)((s << 4) | lengths[s]);
+			}
+		}
+	}
+	return 1;
+}
+
+//! Обратное преобразование: символ за один просмотр таблицы по старшим битам накопителя.
+//! Возвращает 1 если данных хватило на count значений
+int codec_huff_decode(const HuffDecoder_t *decoder, const uint8_t *in, int len, const int8_t *prev, int count, int8_t *cur)
+{
+	uint32_t acc = 0;
+	int bits = 0, pos = 0, left = len * 8;
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		//!Биты выровнены по старшему разряду, за концом входа - нули. Хватает на код и 8 бит после escape
+		while (bits <= 24)
+		{
+			acc |= (uint32_t)(pos < len ? in[pos] : 0) << (24 - bits);
+			pos++;
+			bits += 8;
+		}
+		uint16_t entry = decoder->lut[acc >> (32 - CODEC_HUFF_MAX_LEN)];
+		int codeLen = entry & 0x0F, sym = entry >> 4;
+		if (!codeLen)
+			return 0;
+		acc <<= codeLen;
+		bits -= codeLen;
+		left -= codeLen;
+		if (sym == CODEC_HUFF_ESCAPE)
+		{
+			cur[i] = (int8_t)(acc >> 24);
+			acc <<= 8;
+			bits -= 8;
+			left -= 8;
+		}
+		else
+		{
+			cur[i] = (int8_t)(prev[i] + sym - CODEC_HUFF_DELTA_MAX);
+		}
+		if (left < 0)
+			return 0;
+	}
+	return 1;
+}
+
+//! CRC-16/CCITT (полином 0x1021), crc - начальное значение или результат предыдущего вызова
+uint16_t codec_crc16(uint16_t crc, const uint8_t *data, int len)
+{
+	while (len--)
+	{
+		crc ^= (uint16_t)(*data++) << 8;
+		int i = 0;
+		for (i = 0; i < 8; i++)
+		{
+			crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+//! Выдача накопленного блока с байтом длины впереди
+static void cobs_flush(CobsEncoder_t *cobs)
+{
+	uint8_t code = (uint8_t)(cobs->len + 1);
+	cobs->out(&code, 1);
+	cobs->out(cobs->block, cobs->len);
+	cobs->len = 0;
+}
+
+void codec_cobs_begin(CobsEncoder_t *cobs, void (*out)(const uint8_t *data, int len))
+{
+	cobs->len = 0;
+	cobs->out = out;
+}
+
+//! Очередная часть данных кадра. Нулевой байт закрывает блок, полный блок (0xFF) закрывается без нуля
+RAM_I_TCM void codec_cobs_put(CobsEncoder_t *cobs, const uint8_t *data, int len)
+{
+	int i = 0;
+	for (i = 0; i < len; i++)
+	{
+		if (data[i] == 0)
+		{
+			cobs_flush(cobs);
+			continue;
+		}
+		cobs->block[cobs->len++] = data[i];
+		if (cobs->len == CODEC_COBS_BLOCK)
+		{
+			cobs_flush(cobs);
+		}
+	}
+}
+
+//! Конец кадра: последний блок (возможно пустой) и разделитель 0x00
+void codec_cobs_end(CobsEncoder_t *cobs)
+{
+	static const uint8_t delimiter = 0;
+	cobs_flush(cobs);
+	cobs->out(&delimiter, 1);
+}
+
+#define LZ_MASK			(CODEC_LZ_WINDOW - 1)
+#define LZ_REF_BITS		(1 + CODEC_LZ_WINDOW_BITS + CODEC_LZ_LENGTH_BITS)
+
+void codec_lz_begin(LzEncoder_t *lz)
+{
+	lz->head = 0;
+	lz->pos = 0;
+	lz->acc = 0;
+	lz->bits = 0;
+}
+
+//! Запись count бит value. В накопителе остаётся меньше 8 бит
+static inline uint8_t *lz_bits(LzEncoder_t *lz, uint32_t value, int count, uint8_t *out)
+{
+	lz->acc = lz->acc << count | value;
+	lz->bits += count;
+	while (lz->bits >= 8)
+	{
+		lz->bits -= 8;
+		*out++ = (uint8_t)(lz->acc >> lz->bits);
+	}
+	return out;
+}
+
+//! Кодирование с позиции pos: самый длинный повтор в окне (не длиннее avail ещё не закодированных байт) или литерал.
+//! Поиск перебором смещений от ближнего, сравнение начинается только при совпадении первого байта
+RAM_I_TCM static uint8_t *lz_step(LzEncoder_t *lz, int avail, uint8_t *out)
+{
+	const uint8_t *ring = lz->ring;
+	uint32_t pos = lz->pos;
+	int limit = avail < CODEC_LZ_MATCH_MAX ? avail : CODEC_LZ_MATCH_MAX;
+	int window = pos < CODEC_LZ_OFFSET_MAX ? (int)pos : CODEC_LZ_OFFSET_MAX;
+	int best = 0, bestOff = 0, off = 0;
+	uint8_t first = ring[pos & LZ_MASK];
+	for (off = 1; off <= window && best < limit; off++)
+	{
+		uint32_t from = pos - off;
+		int n = 1;
+		if (ring[from & LZ_MASK] != first)
+			continue;
+		while (n < limit && ring[(from + n) & LZ_MASK] == ring[(pos + n) & LZ_MASK])
+		{
+			n++;
+		}
+		if (n > best)
+		{
+			best = n;
+			bestOff = off;
+		}
+	}
+	if (best >= CODEC_LZ_MIN_MATCH)
+	{
+		out = lz_bits(lz, (uint32_t)(bestOff - 1) << CODEC_LZ_LENGTH_BITS | (uint32_t)(best - CODEC_LZ_MIN_MATCH), LZ_REF_BITS, out);
+		lz->pos += best;
+	}
+	else
+	{
+		out = lz_bits(lz, 0x100 | first, 9, out);
+		lz->pos++;
+	}
+	return out;
+}
+
+//! Очередная часть потока. Байт кодируется, когда за ним накоплено CODEC_LZ_MATCH_MAX байт для поиска повтора.
+//! Возвращает длину сжатых данных в out
+RAM_I_TCM int codec_lz_put(LzEncoder_t *lz, const uint8_t *data, int len, uint8_t *out)
+{
+	uint8_t *start = out;
+	int i = 0;
+	for (i = 0; i < len; i++)
+	{
+		//!Новый байт затирает самый старый байт кольца - он уже дальше CODEC_LZ_OFFSET_MAX от pos
+		if (lz->head - lz->pos == CODEC_LZ_MATCH_MAX)
+		{
+			out = lz_step(lz, CODEC_LZ_MATCH_MAX, out);
+		}
+		lz->ring[lz->head++ & LZ_MASK] = data[i];
+	}
+	return out - start;
+}
+
+//! Конец потока: оставшиеся байты, маркер конца и неполный байт. Кодер готов к следующему потоку
+int codec_lz_end(LzEncoder_t *lz, uint8_t *out)
+{
+	uint8_t *start = out;
+	if (!lz->head)
+		return 0;
+	while (lz->pos != lz->head)
+	{
+		out = lz_step(lz, (int)(lz->head - lz->pos), out);
+	}
+	out = lz_bits(lz, (uint32_t)LZ_MASK << CODEC_LZ_LENGTH_BITS, LZ_REF_BITS, out);
+	if (lz->bits)
+	{
+		*out++ = (uint8_t)(lz->acc << (8 - lz->bits));
+	}
+	codec_lz_begin(lz);
+	return out - start;
+}
+
+//! Раскодирование одного потока до маркера конца (хост). Возвращает длину данных в out, -1 - поток оборван,
+//! испорчен или не помещается в max. used - байт входа, занятых потоком (следующий поток начинается за ними)
+int codec_lz_decode(const uint8_t *in, int len, uint8_t *out, int max, int *used)
+{
+	uint32_t acc = 0;
+	int bits = 0, pos = 0, n = 0;
+	while (1)
+	{
+		while (bits <= 24 && pos < len)
+		{
+			acc = acc << 8 | in[pos++];
+			bits += 8;
+		}
+		if (bits >= 9 && ((acc >> (bits - 1)) & 1))
+		{
+			if (n == max)
+				return -1;
+			out[n++] = (uint8_t)(acc >> (bits - 9));
+			bits -= 9;
+			continue;
+		}
+		if (bits < LZ_REF_BITS)
+			return -1;
+		uint32_t token = acc >> (bits - LZ_REF_BITS);
+		int off = (int)((token >> CODEC_LZ_LENGTH_BITS) & LZ_MASK) + 1;
+		int count = (int)(token & ((1 << CODEC_LZ_LENGTH_BITS) - 1)) + CODEC_LZ_MIN_MATCH;
+		bits -= LZ_REF_BITS;
+		if (off == CODEC_LZ_WINDOW)
+		{
+			*used = pos - bits / 8;
+			return n;
+		}
+		if (off > n || n + count > max)
+			return -1;
+		while (count--)
+		{
+			out[n] = out[n - off];
+			n++;
+		}
+	}
+}
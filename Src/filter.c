@@ -0,0 +1,163 @@
+/*
+ * filter.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "filter.h"
+#include "mpuinit.h"
+#include <string.h>
+
+#if defined(STM32_BUILD) && defined(__ARM_FEATURE_DSP)
+#include "stm32f7xx.h"
+#define FILTER_SIMD
+#endif
+
+//!Состояние фильтра по датчикам. Горячие данные каждого опроса - в DTCM
+typedef struct
+{
+	int8_t *prev1;		//!Предыдущее чтение
+	int8_t *prev2;		//!Чтение перед предыдущим
+	int8_t *ema;		//!Экспоненциальное среднее
+	uint8_t *primed;	//!0xFF - у датчика есть история, 0x00 - первое чтение
+} FilterState_t;
+
+static int8_t prev1[FILTER_SENSORS] RAM_D_TCM CACHE_ALIGNED;
+static int8_t prev2[FILTER_SENSORS] RAM_D_TCM CACHE_ALIGNED;
+static int8_t ema[FILTER_SENSORS] RAM_D_TCM CACHE_ALIGNED;
+static uint8_t primed[FILTER_SENSORS] RAM_D_TCM CACHE_ALIGNED;
+static const FilterState_t state = { prev1, prev2, ema, primed };
+static int shift = 0;	//!0 - фильтр выключен
+
+static inline uint32_t load4(const void *p)
+{
+	uint32_t word;
+	memcpy(&word, p, sizeof(word));
+	return word;
+}
+
+static inline void store4(void *p, uint32_t word)
+{
+	memcpy(p, &word, sizeof(word));
+}
+
+//! Скалярная версия: по одному датчику. Сдвиг вправо отрицательных чисел - арифметический, как у SHADD8
+static void run_scalar(const FilterState_t *s, int first, int count, int8_t *values, const uint8_t *mask, int k)
+{
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		if (!mask[i])
+			continue;
+		int n = first + i;
+		int x = values[i];
+		int a = s->primed[n] ? s->prev2[n] : x;
+		int b = s->primed[n] ? s->prev1[n] : x;
+		int e = s->primed[n] ? s->ema[n] : x;
+		int lo = a < b ? a : b;
+		int hi = a < b ? b : a;
+		int med = hi < x ? hi : x;
+		med = lo > med ? lo : med;
+		int j = 0;
+		for (j = 0; j < k; j++)
+		{
+			med = (e + med) >> 1;
+		}
+		s->prev2[n] = (int8_t)b;
+		s->prev1[n] = (int8_t)x;
+		s->ema[n] = (int8_t)med;
+		s->primed[n] = 0xFF;
+		values[i] = (int8_t)med;
+	}
+}
+
+#ifdef FILTER_SIMD
+//! SIMD-версия: четыре датчика в слове. min/max по байтам - SSUB8 выставляет флаги GE (a >= b), SEL выбирает байты.
+//! Датчики вне mask и хвост после count не меняются (смешивание по маске)
+RAM_I_TCM static void run_simd(const FilterState_t *s, int first, int count, int8_t *values, const uint8_t *mask, int k)
+{
+	int i = 0;
+	for (i = 0; i < count; i += 4)
+	{
+		int n = first + i;
+		uint32_t m = load4(&mask[i]);
+		if (!m)
+			continue;
+		uint32_t x = load4(&values[i]);
+		uint32_t p = load4(&s->primed[n]);
+		//!Первое чтение датчика: история и среднее начинаются с него
+		uint32_t a = (load4(&s->prev2[n]) & p) | (x & ~p);
+		uint32_t b = (load4(&s->prev1[n]) & p) | (x & ~p);
+		uint32_t e = (load4(&s->ema[n]) & p) | (x & ~p);
+		__SSUB8(a, b);
+		uint32_t hi = __SEL(a, b);
+		uint32_t lo = __SEL(b, a);
+		__SSUB8(hi, x);
+		uint32_t med = __SEL(x, hi);	//!min(hi, x)
+		__SSUB8(lo, med);
+		med = __SEL(lo, med);			//!max(lo, min(hi, x))
+		int j = 0;
+		for (j = 0; j < k; j++)
+		{
+			med = __SHADD8(e, med);
+		}
+		store4(&s->prev2[n], (b & m) | (load4(&s->prev2[n]) & ~m));
+		store4(&s->prev1[n], (x & m) | (load4(&s->prev1[n]) & ~m));
+		store4(&s->ema[n], (med & m) | (load4(&s->ema[n]) & ~m));
+		store4(&s->primed[n], p | m);
+		store4(&values[i], (med & m) | (x & ~m));
+	}
+}
+#endif
+
+//! Коэффициент среднего 1 / 2^shift (1..FILTER_SHIFT_MAX), 0 - выключить. Включение начинает историю заново
+void filter_set(int value)
+{
+	shift = value < 0 ? 0 : value > FILTER_SHIFT_MAX ? FILTER_SHIFT_MAX : value;
+	memset(primed, 0, sizeof(primed));
+}
+
+int filter_enabled(void)
+{
+	return shift != 0;
+}
+
+//! Фильтрация порции датчиков first..first + count - 1 на месте. Обновляются только датчики с mask[i] = 0xFF.
+//! first кратно 4; values и mask - буферы, дополненные до кратного 4 размера
+RAM_I_TCM void filter_run(int first, int count, int8_t *values, const uint8_t *mask)
+{
+	if (!shift)
+		return;
+#ifdef FILTER_SIMD
+	run_simd(&state, first, count, values, mask, shift);
+#else
+	run_scalar(&state, first, count, values, mask, shift);
+#endif
+}
+
+//! Замер: проход по FILTER_BENCH датчикам на отдельном состоянии, в тактах, SIMD (0 без DSP) и скалярная версия
+void filter_bench(uint32_t *simdCycles, uint32_t *scalarCycles)
+{
+	static int8_t benchPrev1[FILTER_BENCH] CACHE_ALIGNED, benchPrev2[FILTER_BENCH] CACHE_ALIGNED;
+	static int8_t benchEma[FILTER_BENCH] CACHE_ALIGNED, benchValues[FILTER_BENCH] CACHE_ALIGNED;
+	static uint8_t benchPrimed[FILTER_BENCH] CACHE_ALIGNED, benchMask[FILTER_BENCH] CACHE_ALIGNED;
+	const FilterState_t bench = { benchPrev1, benchPrev2, benchEma, benchPrimed };
+	int k = shift ? shift : 2;
+	int i = 0;
+	for (i = 0; i < FILTER_BENCH; i++)
+	{
+		benchValues[i] = (int8_t)(i * 37);
+		benchMask[i] = 0xFF;
+		benchPrimed[i] = 0xFF;
+	}
+	uint32_t start = cycle_counter_get();
+	run_scalar(&bench, 0, FILTER_BENCH, benchValues, benchMask, k);
+	*scalarCycles = cycle_counter_get() - start;
+	*simdCycles = 0;
+#ifdef FILTER_SIMD
+	start = cycle_counter_get();
+	run_simd(&bench, 0, FILTER_BENCH, benchValues, benchMask, k);
+	*simdCycles = cycle_counter_get() - start;
+#endif
+}
@@ -0,0 +1,535 @@
+/*
+ * flashlog.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "flashlog.h"
+#include "codec.h"
+#include "mpuinit.h"
+#include "rtos_lib.h"
+#include <stddef.h>
+#include <string.h>
+
+//!Заголовок каждой страницы FLASH
+typedef struct
+{
+	uint32_t seq;	//!Поколение сектора, растёт при каждой смене сектора
+	uint32_t epoch;	//!Эпоха первого кадра, начинающегося в странице
+	uint16_t first;	//!Смещение начала этого кадра в данных страницы, NO_FRAME если кадров нет
+	uint16_t crc;	//!CRC-16 полей выше
+} LogPage_t;
+
+//!Позиция чтения в потоке кадров
+typedef struct
+{
+	uint32_t sector;
+	uint32_t page;
+	int off;	//!Позиция в данных страницы
+	int limit;	//!Доступно байт в данных страницы
+	int head;	//!Страница прочитана из RAM (ещё не записана), дальше данных нет
+	uint8_t buf[QSPI_PAGE_SIZE];
+} LogReader_t;
+
+#define PAGES_PER_SECTOR	(FLASHLOG_SECTOR_SIZE / QSPI_PAGE_SIZE)
+#define ERASE_STEPS			(FLASHLOG_SECTOR_SIZE / QSPI_ERASE_SIZE)
+#define PAGE_PAYLOAD		(QSPI_PAGE_SIZE - (int)sizeof(LogPage_t))
+#define FRAME_MAX			(sizeof(LogFrame_t) + CODEC_DELTA_MAX(FLASHLOG_SENSORS_MAX))
+#define NO_FRAME			0xFFFF
+
+//!Поколение каждого сектора (FLASHLOG_NONE - пуст) и разреженный индекс: эпоха первого кадра сектора
+static uint32_t sectorSeq[FLASHLOG_SECTORS];
+static uint32_t sectorEpoch[FLASHLOG_SECTORS];
+
+//!Заполняемая страница, пишется во FLASH только целиком
+static uint8_t page[QSPI_PAGE_SIZE];
+static int pageFill;
+static uint32_t headSector, headPage, headSeq;
+//!Сектор, стираемый заранее, и количество уже стёртых в нём блоков
+static uint32_t eraseSector;
+static int eraseStep;
+
+static int8_t prevValues[FLASHLOG_SENSORS_MAX];
+static int prevCount;
+static int sinceKey;
+static uint32_t lastEpoch = FLASHLOG_NONE;
+static uint8_t frameBuf[FRAME_MAX];	//!Кадр на запись (процесс журнала)
+static uint8_t readBuf[FRAME_MAX];	//!Кадр на чтение (процесс отправки истории)
+static LogReader_t reader, keyReader, frameStart;
+static HuffTable_t huffTable;
+static uint16_t huffTag;		//!0 - таблица не загружена, кадры пишутся полубайтовой дельтой
+static uint32_t codecStats[FLASHLOG_STATS];
+static int logSemaphore;
+static int ready = 0;
+
+static uint32_t page_addr(uint32_t sector, uint32_t pageNum)
+{
+	return sector * FLASHLOG_SECTOR_SIZE + pageNum * QSPI_PAGE_SIZE;
+}
+
+static uint16_t page_crc(const LogPage_t *h)
+{
+	return codec_crc16(0xFFFF, (const uint8_t *)h, offsetof(LogPage_t, crc));
+}
+
+static int page_valid(const LogPage_t *h)
+{
+	return h->seq != FLASHLOG_NONE && h->crc == page_crc(h);
+}
+
+static void page_reset(void)
+{
+	LogPage_t *h = (LogPage_t *)page;
+	memset(page, 0xFF, sizeof(page));
+	h->epoch = FLASHLOG_NONE;
+	h->first = NO_FRAME;
+	pageFill = 0;
+}
+
+//! Стирание одного блока заранее стираемого сектора
+static void erase_step(void)
+{
+	if (eraseStep < ERASE_STEPS)
+	{
+		qspi_erase(eraseSector * FLASHLOG_SECTOR_SIZE + eraseStep * QSPI_ERASE_SIZE);
+		eraseStep++;
+	}
+}
+
+//! Переход записи в следующий сектор: он должен быть стёрт, следующий за ним начинает стираться
+static void start_sector(uint32_t sector)
+{
+	if (eraseSector == sector)
+	{
+		while (eraseStep < ERASE_STEPS)
+		{
+			erase_step();
+		}
+	}
+	headSector = sector;
+	headPage = 0;
+	headSeq++;
+	sectorSeq[sector] = headSeq;
+	sectorEpoch[sector] = FLASHLOG_NONE;
+	sinceKey = FLASHLOG_KEYFRAME_INTERVAL; //!Первый кадр сектора - опорный
+
+	eraseSector = (sector + 1) % FLASHLOG_SECTORS;
+	eraseStep = 0;
+	sectorSeq[eraseSector] = FLASHLOG_NONE;
+	sectorEpoch[eraseSector] = FLASHLOG_NONE;
+}
+
+static void flush_page(void)
+{
+	LogPage_t *h = (LogPage_t *)page;
+	h->seq = headSeq;
+	h->crc = page_crc(h);
+	qspi_write(page_addr(headSector, headPage), page, QSPI_PAGE_SIZE);
+	page_reset();
+	if (++headPage == PAGES_PER_SECTOR)
+	{
+		start_sector((headSector + 1) % FLASHLOG_SECTORS);
+	}
+}
+
+static void write_bytes(const uint8_t *data, int len)
+{
+	while (len)
+	{
+		int n = PAGE_PAYLOAD - pageFill;
+		if (n > len)
+			n = len;
+		memcpy(&page[sizeof(LogPage_t) + pageFill], data, n);
+		pageFill += n;
+		data += n;
+		len -= n;
+		if (pageFill == PAGE_PAYLOAD)
+		{
+			flush_page();
+		}
+	}
+}
+
+//! Загрузка страницы читателя: заполняемая страница копируется из RAM, остальные читаются из FLASH
+static int reader_load(LogReader_t *r)
+{
+	int ok = 0;
+	if (rtos_semaphore_take(logSemaphore, -1))
+	{
+		if (r->sector == headSector && r->page == headPage)
+		{
+			memcpy(r->buf, page, QSPI_PAGE_SIZE);
+			r->limit = pageFill;
+			r->head = 1;
+			ok = 1;
+		}
+		else if (sectorSeq[r->sector] != FLASHLOG_NONE && (r->sector != headSector || r->page < headPage))
+		{
+			LogPage_t *h = (LogPage_t *)r->buf;
+			ok = qspi_read(page_addr(r->sector, r->page), r->buf, QSPI_PAGE_SIZE) &&
+					page_valid(h) && h->seq == sectorSeq[r->sector];
+			r->limit = PAGE_PAYLOAD;
+			r->head = 0;
+		}
+		rtos_semaphore_give(logSemaphore);
+	}
+	r->off = 0;
+	return ok;
+}
+
+static int reader_next_page(LogReader_t *r)
+{
+	if (r->head)
+		return 0;
+	if (++r->page == PAGES_PER_SECTOR)
+	{
+		r->page = 0;
+		r->sector = (r->sector + 1) % FLASHLOG_SECTORS;
+	}
+	return reader_load(r);
+}
+
+static int reader_read(LogReader_t *r, uint8_t *dst, int len)
+{
+	while (len)
+	{
+		if (r->off >= r->limit && !reader_next_page(r))
+			return 0;
+		int n = r->limit - r->off;
+		if (n > len)
+			n = len;
+		memcpy(dst, &r->buf[sizeof(LogPage_t) + r->off], n);
+		r->off += n;
+		dst += n;
+		len -= n;
+	}
+	return 1;
+}
+
+//! Переход к ближайшему началу кадра, начиная с текущей загруженной страницы
+static int reader_seek_frame(LogReader_t *r)
+{
+	while (1)
+	{
+		LogPage_t *h = (LogPage_t *)r->buf;
+		if (h->first != NO_FRAME && h->first < r->limit)
+		{
+			r->off = h->first;
+			return 1;
+		}
+		if (!reader_next_page(r))
+			return 0;
+	}
+}
+
+//! Чтение кадра в readBuf с проверкой CRC. Возвращает полную длину кадра или 0
+static int reader_frame(LogReader_t *r)
+{
+	LogFrame_t *f = (LogFrame_t *)readBuf;
+	if (!reader_read(r, readBuf, sizeof(LogFrame_t)) ||
+			f->magic != FLASHLOG_FRAME_MAGIC || f->len > FRAME_MAX - sizeof(LogFrame_t) ||
+			!reader_read(r, readBuf + sizeof(LogFrame_t), f->len))
+		return 0;
+	uint16_t crc = f->crc;
+	f->crc = 0;
+	if (codec_crc16(0xFFFF, readBuf, sizeof(LogFrame_t) + f->len) != crc)
+		return 0;
+	f->crc = crc;
+	return sizeof(LogFrame_t) + f->len;
+}
+
+//! Позиционирование на первый кадр сектора
+static int reader_start(LogReader_t *r, uint32_t sector)
+{
+	r->sector = sector;
+	r->page = 0;
+	r->head = 0;
+	return reader_load(r) && reader_seek_frame(r);
+}
+
+//! Восстановление после сброса: поиск последнего сектора и первой чистой страницы в нём
+int flashlog_init(void)
+{
+	LogPage_t h;
+	uint32_t best = FLASHLOG_NONE;
+	uint32_t s = 0;
+	uint32_t p = 0;
+
+	logSemaphore = rtos_semaphore_init();
+	if (!qspi_init())
+		return 0;
+
+	headSeq = 0;
+	for (s = 0; s < FLASHLOG_SECTORS; s++)
+	{
+		sectorSeq[s] = FLASHLOG_NONE;
+		sectorEpoch[s] = FLASHLOG_NONE;
+		if (qspi_read(page_addr(s, 0), &h, sizeof(h)) && page_valid(&h))
+		{
+			sectorSeq[s] = h.seq;
+			if (best == FLASHLOG_NONE || h.seq > headSeq)
+			{
+				best = s;
+				headSeq = h.seq;
+			}
+			for (p = 0; p < PAGES_PER_SECTOR; p++)
+			{
+				if (p && (!qspi_read(page_addr(s, p), &h, sizeof(h)) || !page_valid(&h)))
+					break;
+				if (h.first != NO_FRAME)
+				{
+					sectorEpoch[s] = h.epoch;
+					break;
+				}
+			}
+		}
+	}
+
+	page_reset();
+	if (best == FLASHLOG_NONE)
+	{
+		//!Пустая FLASH
+		eraseSector = 0;
+		eraseStep = 0;
+		start_sector(0);
+	}
+	else
+	{
+		//!Первая полностью стёртая страница; недописанные при сбросе страницы пропускаются
+		headSector = best;
+		for (p = 1; p < PAGES_PER_SECTOR; p++)
+		{
+			int i = 0;
+			qspi_read(page_addr(best, p), page, QSPI_PAGE_SIZE);
+			for (i = 0; i < QSPI_PAGE_SIZE && page[i] == 0xFF; i++);
+			if (i == QSPI_PAGE_SIZE)
+				break;
+		}
+		page_reset();
+		headPage = p;
+		eraseSector = (best + 1) % FLASHLOG_SECTORS;
+		eraseStep = 0;
+		sectorSeq[eraseSector] = FLASHLOG_NONE;
+		sectorEpoch[eraseSector] = FLASHLOG_NONE;
+		if (headPage == PAGES_PER_SECTOR)
+		{
+			start_sector(eraseSector);
+		}
+		sinceKey = FLASHLOG_KEYFRAME_INTERVAL;
+
+		//!Эпоха последнего целого кадра: проход по кадрам последнего непустого сектора
+		s = sectorEpoch[best] != FLASHLOG_NONE ? best : (best + FLASHLOG_SECTORS - 1) % FLASHLOG_SECTORS;
+		if (sectorEpoch[s] != FLASHLOG_NONE && reader_start(&reader, s))
+		{
+			do
+			{
+				if (reader_frame(&reader))
+				{
+					lastEpoch = ((LogFrame_t *)readBuf)->epoch;
+				}
+				else if (!reader_next_page(&reader) || !reader_seek_frame(&reader))
+				{
+					break;
+				}
+			} while (1);
+		}
+	}
+	ready = 1;
+	return 1;
+}
+
+uint32_t flashlog_last_epoch(void)
+{
+	return lastEpoch;
+}
+
+//! Добавление снимка в журнал. Опорный кадр пишется в начале сектора и раз в FLASHLOG_KEYFRAME_INTERVAL кадров
+int flashlog_append(uint32_t epoch, const int8_t *values, int count)
+{
+	if (!ready || count > FLASHLOG_SENSORS_MAX)
+		return 0;
+	if (!rtos_semaphore_take(logSemaphore, -1))
+		return 0;
+
+	LogFrame_t *f = (LogFrame_t *)frameBuf;
+	uint8_t *data = frameBuf + sizeof(LogFrame_t);
+	f->magic = FLASHLOG_FRAME_MAGIC;
+	f->count = (uint16_t)count;
+	f->epoch = epoch;
+	f->crc = 0;
+	if (sinceKey >= FLASHLOG_KEYFRAME_INTERVAL || count != prevCount)
+	{
+		f->codec = FLASHLOG_KEY;
+		memcpy(data, values, count);
+		f->len = (uint16_t)count;
+		sinceKey = 0;
+	}
+	else
+	{
+		//!Код Хаффмана пишется, только если он короче полубайтовой дельты
+		int size = codec_delta_size(values, prevValues, count);
+		int huff = 0;
+		if (huffTag && size > 3)
+		{
+			huff = codec_huff_encode(&huffTable, values, prevValues, count, data + 2, size - 3);
+		}
+		if (huff)
+		{
+			f->codec = FLASHLOG_HUFF;
+			data[0] = (uint8_t)huffTag;
+			data[1] = (uint8_t)(huffTag >> 8);
+			f->len = (uint16_t)(huff + 2);
+		}
+		else
+		{
+			f->codec = FLASHLOG_DELTA;
+			f->len = (uint16_t)codec_delta_encode(values, prevValues, count, data);
+		}
+		codecStats[FLASHLOG_FRAMES]++;
+		codecStats[FLASHLOG_RAW_BYTES] += count;
+		codecStats[FLASHLOG_NIBBLE_BYTES] += size;
+		codecStats[FLASHLOG_WRITTEN_BYTES] += f->len;
+	}
+	sinceKey++;
+	f->crc = codec_crc16(0xFFFF, frameBuf, sizeof(LogFrame_t) + f->len);
+
+	LogPage_t *h = (LogPage_t *)page;
+	if (h->first == NO_FRAME)
+	{
+		h->first = (uint16_t)pageFill;
+		h->epoch = epoch;
+	}
+	if (sectorEpoch[headSector] == FLASHLOG_NONE)
+	{
+		sectorEpoch[headSector] = epoch;
+	}
+	write_bytes(frameBuf, sizeof(LogFrame_t) + f->len);
+
+	memcpy(prevValues, values, count);
+	prevCount = count;
+	lastEpoch = epoch;
+	erase_step();
+
+	rtos_semaphore_give(logSemaphore);
+	return 1;
+}
+
+//! Отправка сохранённых кадров с эпохами from..to. Отдача начинается с ближайшего опорного кадра,
+//! чтобы дельты можно было раскодировать. Возвращает количество отправленных кадров
+int flashlog_history(uint32_t from, uint32_t to, void (*send)(const uint8_t *data, int len))
+{
+	uint32_t start = FLASHLOG_NONE;
+	uint32_t k = 0;
+	int haveKey = 0;
+	int streaming = 0;
+	int sent = 0;
+
+	if (!ready || from > to)
+		return 0;
+	//!Самый новый сектор, начинающийся не позже from (или самый старый)
+	if (rtos_semaphore_take(logSemaphore, -1))
+	{
+		for (k = 1; k <= FLASHLOG_SECTORS; k++)
+		{
+			uint32_t s = (headSector + k) % FLASHLOG_SECTORS;
+			if (sectorSeq[s] == FLASHLOG_NONE || sectorEpoch[s] == FLASHLOG_NONE)
+				continue;
+			if (start == FLASHLOG_NONE || sectorEpoch[s] <= from)
+				start = s;
+		}
+		rtos_semaphore_give(logSemaphore);
+	}
+	if (start == FLASHLOG_NONE || !reader_start(&reader, start))
+		return 0;
+
+	while (1)
+	{
+		frameStart = reader;
+		int len = reader_frame(&reader);
+		if (!len)
+		{
+			if (!reader_next_page(&reader) || !reader_seek_frame(&reader))
+				break;
+			continue;
+		}
+		LogFrame_t *f = (LogFrame_t *)readBuf;
+		if (f->epoch > to)
+			break;
+		if (!streaming)
+		{
+			if (f->epoch < from)
+			{
+				if (f->codec == FLASHLOG_KEY)
+				{
+					keyReader = frameStart;
+					haveKey = 1;
+				}
+				continue;
+			}
+			streaming = 1;
+			if (f->codec != FLASHLOG_KEY && haveKey)
+			{
+				reader = keyReader;
+				continue;
+			}
+		}
+		send(readBuf, len);
+		sent++;
+	}
+	return sent;
+}
+
+//! Таблица кода Хаффмана для дельта-кадров: длины кодов CODEC_HUFF_SYMBOLS символов, все нули - выключить.
+//! Метка таблицы пишется в каждый кадр, по ней хост выбирает свою копию таблицы. Замеры начинаются заново
+int flashlog_huff_set(const uint8_t *lengths)
+{
+	int ok = 1;
+	int s = 0;
+	uint8_t used = 0;
+	for (s = 0; s < CODEC_HUFF_SYMBOLS; s++)
+	{
+		used |= lengths[s];
+	}
+	if (!rtos_semaphore_take(logSemaphore, -1))
+		return 0;
+	if (!used)
+	{
+		huffTag = 0;
+	}
+	else if (codec_huff_table(lengths, &huffTable))
+	{
+		//!Метка 0 означает "нет таблицы"
+		huffTag = codec_crc16(0xFFFF, lengths, CODEC_HUFF_SYMBOLS);
+		huffTag = huffTag ? huffTag : 1;
+	}
+	else
+	{
+		ok = 0;
+	}
+	if (ok)
+	{
+		memset(codecStats, 0, sizeof(codecStats));
+	}
+	rtos_semaphore_give(logSemaphore);
+	return ok;
+}
+
+//! Замеры кодирования дельта-кадров (FLASHLOG_STATS значений)
+void flashlog_codec_stats(uint32_t *out)
+{
+	memcpy(out, codecStats, sizeof(codecStats));
+	out[FLASHLOG_TABLE] = huffTag;
+}
+
+//! Работа с QSPI вне журнала (сохранение калибровки) под семафором журнала: драйвер QSPI не реентерабелен,
+//! а FLASH кроме процесса журнала читает процесс UART (history). Возвращает результат job, 0 - семафор не взят
+int flashlog_locked(int (*job)(void))
+{
+	int ok = 0;
+	if (!rtos_semaphore_take(logSemaphore, -1))
+		return 0;
+	ok = job();
+	rtos_semaphore_give(logSemaphore);
+	return ok;
+}
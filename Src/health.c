@@ -0,0 +1,138 @@
+/*
+ * health.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "health.h"
+#include "mpuinit.h"
+
+//!8 байт на датчик: при 4096 датчиках таблица занимает 32 КБ
+typedef struct
+{
+	uint8_t reason;		//!Причина последнего плохого чтения
+	uint8_t bad : 4;	//!Плохих чтений подряд (до 15)
+	uint8_t good : 3;	//!Исправных чтений подряд в карантине
+	uint8_t valid : 1;	//!Есть принятое значение для контроля скачков
+	int8_t last;		//!Последнее прочитанное значение
+	uint16_t same;		//!Одинаковых чтений подряд
+	uint16_t backoff;	//!Пауза опроса в карантине, мс
+} Health_t;
+
+static Health_t health[HEALTH_SENSORS];
+static uint32_t quarantine[HEALTH_SENSORS / 32];
+static int stuckLimit = 0; //!0 - контроль залипания выключен: в стабильном помещении значение может не меняться часами
+static int jumpMax = HEALTH_JUMP_DEFAULT;
+
+//! Пороги: залипание после stuckReads одинаковых чтений (0 - не контролировать), скачок больше jump °C
+void health_set(int stuckReads, int jump)
+{
+	stuckLimit = stuckReads < 0 ? 0 : stuckReads > 0xFFFF ? 0xFFFF : stuckReads;
+	jumpMax = jump < 1 ? 1 : jump;
+}
+
+//! Результат чтения датчика. ok - чтение без ошибки, accepted - последнее принятое значение.
+//! Возвращает 1, если значение можно принять в снимок
+RAM_I_TCM int health_check(int sensor, int ok, int8_t value, int8_t accepted)
+{
+	Health_t *h = &health[sensor];
+	uint32_t mask = 1u << (sensor & 31);
+	int quarantined = (quarantine[sensor >> 5] & mask) != 0;
+	uint8_t reason = 0;
+	if (!ok)
+	{
+		reason |= HEALTH_FAIL;
+	}
+	else
+	{
+		if (value < HEALTH_RANGE_MIN || value > HEALTH_RANGE_MAX)
+		{
+			reason |= HEALTH_RANGE;
+		}
+		//!В карантине последнее принятое значение устарело, скачок не проверяется
+		int diff = value - accepted;
+		if (!quarantined && h->valid && (diff > jumpMax || diff < -jumpMax))
+		{
+			reason |= HEALTH_JUMP;
+		}
+		if (value == h->last && h->same < 0xFFFF)
+		{
+			h->same++;
+		}
+		else if (value != h->last)
+		{
+			h->same = 0;
+		}
+		h->last = value;
+		if (stuckLimit && h->same >= stuckLimit)
+		{
+			reason |= HEALTH_STUCK;
+		}
+	}
+
+	if (reason)
+	{
+		h->reason = reason;
+		h->good = 0;
+		if (h->bad < 15)
+		{
+			h->bad++;
+		}
+		if (!quarantined && (h->bad >= HEALTH_BAD_READS || (reason & HEALTH_STUCK)))
+		{
+			quarantine[sensor >> 5] |= mask;
+			h->backoff = HEALTH_BACKOFF_MIN;
+		}
+		return 0;
+	}
+	h->bad = 0;
+	if (quarantined)
+	{
+		if (++h->good < HEALTH_RECOVER_READS)
+			return 0;
+		quarantine[sensor >> 5] &= ~mask;
+		h->reason = 0;
+		h->good = 0;
+	}
+	h->valid = 1;
+	return 1;
+}
+
+int health_quarantined(int sensor)
+{
+	return (quarantine[sensor >> 5] >> (sensor & 31)) & 1;
+}
+
+uint8_t health_reason(int sensor)
+{
+	return health[sensor].reason;
+}
+
+//! Пауза до следующего опроса датчика в карантине, каждая следующая вдвое больше
+RAM_I_TCM uint32_t health_backoff(int sensor)
+{
+	Health_t *h = &health[sensor];
+	uint32_t backoff = h->backoff;
+	h->backoff = backoff * 2 > HEALTH_BACKOFF_MAX ? HEALTH_BACKOFF_MAX : (uint16_t)(backoff * 2);
+	return backoff;
+}
+
+//! Битовая карта карантина датчиков first..first + count - 1 (first кратно 8): бит (sensor - first) % 8
+//! байта (sensor - first) / 8. Возвращает размер в байтах
+int health_bitmap(int first, int count, uint8_t *out)
+{
+	int bytes = (count + 7) / 8;
+	int i = 0;
+	first /= 8;
+	for (i = 0; i < bytes; i++)
+	{
+		int byte = first + i;
+		out[i] = (uint8_t)(quarantine[byte >> 2] >> ((byte & 3) * 8));
+	}
+	if (count & 7)
+	{
+		out[bytes - 1] &= (uint8_t)((1 << (count & 7)) - 1);
+	}
+	return bytes;
+}
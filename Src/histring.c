@@ -0,0 +1,68 @@
+/*
+ * histring.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "histring.h"
+#include "mpuinit.h"
+
+static volatile int8_t *ring = 0;	//!ring[sensor * HISTRING_DEPTH + позиция]
+static volatile uint32_t head = 0;	//!Количество добавленных снимков, публикуется после записи
+
+int histring_init(void)
+{
+	uint32_t size = 0;
+	ring = (volatile int8_t *)psram_init(&size);
+	if (size < HISTRING_SENSORS * HISTRING_DEPTH)
+	{
+		ring = 0;
+	}
+	return ring != 0;
+}
+
+//! Добавление снимка: по одному значению на датчик, позиция head публикуется после записи
+RAM_I_TCM void histring_append(const int8_t *values)
+{
+	if (!ring)
+		return;
+	volatile int8_t *slot = ring + (head % HISTRING_DEPTH);
+	int i = 0;
+	for (i = 0; i < HISTRING_SENSORS; i++)
+	{
+		*slot = values[i];
+		slot += HISTRING_DEPTH;
+	}
+	memory_barrier();
+	head = head + 1;
+}
+
+uint32_t histring_head(void)
+{
+	return head;
+}
+
+//! Копирование count значений датчика начиная с порядкового номера снимка first.
+//! Возвращает 0, если диапазон уже перезаписан (или ещё не записан)
+int histring_read(int sensor, uint32_t first, int count, int8_t *out)
+{
+	if (!ring || sensor < 0 || sensor >= HISTRING_SENSORS || count <= 0)
+		return 0;
+	uint32_t before = head;
+	if (first + count > before || before - first > HISTRING_DEPTH - HISTRING_GUARD)
+		return 0;
+
+	const volatile int8_t *row = ring + sensor * HISTRING_DEPTH;
+	uint32_t pos = first % HISTRING_DEPTH;
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		out[i] = row[pos];
+		if (++pos == HISTRING_DEPTH)
+			pos = 0;
+	}
+	memory_barrier();
+	//!За время копирования запись продвинулась на head - before позиций и могла затереть начало диапазона
+	return head - first <= HISTRING_DEPTH - HISTRING_GUARD;
+}
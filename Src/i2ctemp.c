@@ -0,0 +1,225 @@
+/*
+ * i2ctemp.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "i2ctemp.h"
+#include "mpuinit.h"
+
+#define WORDS		((I2CTEMP_SENSORS + 31) / 32)
+#define CORE_MHZ	216	//!Частота ядра (SystemClock_Config) для перевода тактов в мкс
+
+//!Устройства, ожидающие чтения (номера внутри шины). Ставит процесс опроса, снимает прерывание окончания
+static uint32_t pending[WORDS];
+static volatile uint8_t result[I2CTEMP_SENSORS];	//!SENSOR_SKIP - не читалось с прошлой выдачи
+static volatile int8_t values[I2CTEMP_SENSORS];
+static uint8_t rxData[CACHE_LINE_SIZE] RAM_DMA;
+static int busy = 0;		//!Цепочка идёт: ею владеет прерывание окончания
+static int current = 0;		//!Устройство текущего чтения
+static int ready = 0;
+static uint32_t chainStart = 0;
+static uint32_t stats[I2CTEMP_STATS], chainStats[I2CTEMP_STATS];
+
+static void i2ctemp_complete(int error);
+
+#ifdef STM32_BUILD
+#define bus_start(address, data)	i2c_read_dma(address, I2CTEMP_REG, data, 2)
+#define bus_time_us()				((cycle_counter_get() - chainStart) / CORE_MHZ)
+#else
+//!Имитация шины: чтение завершается, когда процесс опроса проверяет готовность. Последнее устройство не отвечает
+static int simAddress = -1;
+static uint8_t *simData;
+static uint32_t simTime = 0;	//!Время на проводе, мкс
+
+static int bus_start(uint8_t address, uint8_t *data)
+{
+	if (simAddress >= 0)
+		return 0;
+	simAddress = address;
+	simData = data;
+	return 1;
+}
+
+//! Обработка чтений до конца цепочки. Чтение регистра (S, адрес, регистр, Sr, адрес, 2 байта, P) - 48 бит,
+//! NACK на адрес - 11 бит, бит на 400 кГц - 2.5 мкс
+static void sim_run(void)
+{
+	while (simAddress >= 0)
+	{
+		int address = simAddress;
+		int present = address != I2CTEMP_ADDR_FIRST + I2CTEMP_SENSORS - 1;
+		simAddress = -1;
+		if (present)
+		{
+			simData[0] = (uint8_t)(20 + (address & 7));
+			simData[1] = 0x80;
+		}
+		simTime += (present ? 48 : 11) * 5 / 2;
+		i2ctemp_complete(!present);
+	}
+}
+
+#define bus_time_us()	(simTime - chainStart)
+#endif
+
+//! Первое устройство с запросом чтения начиная с from, -1 - нет
+RAM_I_TCM static int next_pending(int from)
+{
+	int w = 0;
+	for (w = from / 32; w < WORDS; w++)
+	{
+		uint32_t bits = __atomic_load_n(&pending[w], __ATOMIC_ACQUIRE);
+		if (w == from / 32)
+		{
+			bits &= ~0UL << (from % 32);
+		}
+		if (bits)
+			return w * 32 + __builtin_ctz(bits);
+	}
+	return -1;
+}
+
+//! Снятие запроса с результатом. Результат виден раньше, чем снят запрос
+RAM_I_TCM static void finish(int dev, int error)
+{
+	result[dev] = error ? SENSOR_FAIL : SENSOR_OK;
+	chainStats[error ? I2CTEMP_ERRORS : I2CTEMP_READS]++;
+	__atomic_fetch_and(&pending[dev / 32], ~(1UL << (dev % 32)), __ATOMIC_RELEASE);
+}
+
+//! Запуск чтения следующего запрошенного устройства начиная с from (по кругу). 0 - запросов больше нет
+RAM_I_TCM static int chain_next(int from)
+{
+	int dev = next_pending(from);
+	if (dev < 0)
+	{
+		dev = next_pending(0);
+	}
+	while (dev >= 0)
+	{
+		current = dev;
+		if (bus_start(I2CTEMP_ADDR_FIRST + dev, rxData))
+			return 1;
+		finish(dev, 1);
+		dev = next_pending(0);
+	}
+	return 0;
+}
+
+//! Запуск цепочки, если она стоит. Цепочку ведёт тот, кто перевёл busy из 0 в 1
+RAM_I_TCM static void chain_kick(void)
+{
+	while (next_pending(0) >= 0 && !__atomic_exchange_n(&busy, 1, __ATOMIC_ACQ_REL))
+	{
+		int i = 0;
+		for (i = 0; i < I2CTEMP_STATS; i++)
+		{
+			chainStats[i] = 0;
+		}
+#ifdef STM32_BUILD
+		chainStart = cycle_counter_get();
+#else
+		chainStart = simTime;
+#endif
+		if (chain_next(0))
+			return;
+		__atomic_store_n(&busy, 0, __ATOMIC_RELEASE);
+	}
+}
+
+//! Прерывание окончания чтения: значение с округлением до градуса и запуск следующего чтения цепочки
+RAM_I_TCM static void i2ctemp_complete(int error)
+{
+	uint32_t start = cycle_counter_get();
+	int dev = current;
+	if (!error)
+	{
+		int raw = (int16_t)((rxData[0] << 8) | rxData[1]);
+		int value = (raw + 128) >> 8;
+		values[dev] = (int8_t)(value > 127 ? 127 : value);
+	}
+	finish(dev, error);
+	int more = chain_next(dev + 1);
+	chainStats[I2CTEMP_CYCLES] += cycle_counter_get() - start;
+	if (!more)
+	{
+		int i = 0;
+		chainStats[I2CTEMP_TIME_US] = bus_time_us();
+		for (i = 0; i < I2CTEMP_STATS; i++)
+		{
+			stats[i] = chainStats[i];
+		}
+		__atomic_store_n(&busy, 0, __ATOMIC_RELEASE);
+		//!Запросы, поставленные после просмотра набора, цепочка не увидела
+		chain_kick();
+	}
+}
+
+int i2ctemp_init(void)
+{
+#ifdef STM32_BUILD
+	ready = i2c_init(i2ctemp_complete);
+#else
+	ready = 1;
+#endif
+	return ready;
+}
+
+//! Замеры последней законченной цепочки (I2CTEMP_STATS значений)
+void i2ctemp_stats(uint32_t *out)
+{
+	int i = 0;
+	for (i = 0; i < I2CTEMP_STATS; i++)
+	{
+		out[i] = stats[i];
+	}
+}
+
+static int i2ctemp_begin(const SensorBus_t *bus, const uint32_t *set, int first, int count)
+{
+	int i = 0;
+	if (!ready)
+		return 0;
+	for (i = first; i < first + count; i++)
+	{
+		if (set[i / 32] & (1UL << (i % 32)))
+		{
+			int dev = i - bus->first;
+			__atomic_fetch_or(&pending[dev / 32], 1UL << (dev % 32), __ATOMIC_RELEASE);
+		}
+	}
+	chain_kick();
+	return 1;
+}
+
+static int i2ctemp_ready(const SensorBus_t *bus)
+{
+	(void)bus;
+#ifndef STM32_BUILD
+	sim_run();
+#endif
+	return !__atomic_load_n(&busy, __ATOMIC_ACQUIRE);
+}
+
+//! Устройства, чтение которых ещё не закончено, отдаются с ошибкой
+static int i2ctemp_batch(const SensorBus_t *bus, int first, int count, int8_t *out, uint8_t *status)
+{
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		int dev = first + i - bus->first;
+		if (__atomic_load_n(&pending[dev / 32], __ATOMIC_ACQUIRE) & (1UL << (dev % 32)))
+		{
+			status[i] = SENSOR_FAIL;
+			continue;
+		}
+		status[i] = result[dev];
+		out[i] = values[dev];
+		result[dev] = SENSOR_SKIP;
+	}
+	return ready;
+}
+
+const SensorDriver_t i2ctemp_driver = { i2ctemp_begin, i2ctemp_ready, i2ctemp_batch };
@@ -21,24 +21,148 @@
 #include "mpuinit.h"
 #include "rtos_lib.h"
 #include "sensors.h"
+#include "flashlog.h"
+#include "histring.h"
+#include "agg.h"
+#include "alarm.h"
+#include "poll.h"
+#include "health.h"
+#include "registry.h"
+#include "filter.h"
+#include "analog.h"
+#include "calib.h"
+#include "i2ctemp.h"
+#include "onewire.h"
+#include "proto.h"
+#include "codec.h"
+#include "replycache.h"
+#include <stdlib.h>
+#include <string.h>
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+#define READ_CHUNK 256 //!Датчиков в одной порции ответа read
+#define TX_FRAME_MAX (READ_CHUNK * 4 + READ_CHUNK / 4 + 16) //!Максимальный размер порции ответа: заголовок, 256 значений по 4 символа, карта карантина
+#ifndef ACQ_WORKERS
+#define ACQ_WORKERS 2 //!Процессов опроса датчиков (например, по одному на шину), каждый опрашивает свой диапазон шардов
+#endif
+#define COMMAND_LINE_MAX 32 //!Максимальная длина команды с аргументами
+#define COMMAND_ARGS_MAX 4
+#define AGG_CHUNK 32 //!Датчиков в одной порции ответа agg
+#define LIST_CHUNK 32 //!Устройств в одной порции ответа list
+#define BAUD_CONFIRM_MS 1000 //!Ожидание повтора команды baud на новой скорости, потом возврат к прежней
+#define BAUD_DRAIN_MS 200 //!Не дольше стольких мс ждать выдачи ответа перед сменой скорости
+#define TX_STALL_MAX_MS 500 //!Ответ, простоявший на полной очереди передачи дольше, обрывается
+#ifndef LINKS
+#define LINKS 2 //!Каналов связи с потребителями: канал i работает через порт i (сервер - UART4, консоль - ST-LINK)
+#endif
+#if LINKS > UART_PORTS
+#error "LINKS exceeds UART_PORTS"
+#endif
+#define LINK_RX_SIZE 256 //!Кольцо приёма канала (степень двойки)
+#define LINK_TX_SIZE 2048 //!Кольцо передачи канала (степень двойки)
+#define LZ_CHUNK 512 //!Ответ сжимается порциями, сжатая порция уходит дальше как обычная часть ответа
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
-uint8_t UARTTx_buff;
-uint8_t UARTRx_buff;
-static uint8_t messType = 0;
-static int8_t temperatures[256];
+//!Счётчики передачи канала (команда txstat)
+enum
+{
+	TX_STALL_MS,	//!Ожидание процесса UART на полной очереди передачи, мс
+	TX_COALESCED,	//!read, слитые с уже ожидающим (он ответит самым свежим снимком)
+	TX_DROPPED,		//!Ответы, оборванные после TX_STALL_MAX_MS ожидания
+	TX_LZ_IN,		//!Байт ответов до сжатия LZ
+	TX_LZ_OUT,		//!Байт после сжатия
+	TX_STATS
+};
+//!Канал связи с потребителем: свой порт, разбор входной строки, очередь передачи, формат ответов и подписка
+typedef struct
+{
+	int port;
+	Ring_t rx;		//!Принятые байты, заполняет прерывание порта
+	Ring_t tx;		//!Байты на передачу, забирает прерывание порта
+	uint8_t rxBuf[LINK_RX_SIZE];
+	uint8_t txBuf[LINK_TX_SIZE];
+	uint8_t messType;
+	uint8_t frameMode;	//!Ответы потоком или кадрами (proto.c)
+	uint16_t frameSeq;	//!Номер следующего кадра канала
+	uint8_t cobsMode;	//!Двоичные ответы в COBS
+	uint8_t lzMode;		//!Каждый ответ - поток LZ (codec_lz_put)
+	uint8_t subscribed;	//!Рассылка каждого опубликованного снимка
+	uint8_t readQueued;	//!read стоит в очереди запросов и ещё не взят процессом UART
+	uint8_t txDropping;	//!Остаток текущего ответа отбрасывается
+	uint32_t txStall;	//!Ожидание на полной очереди передачи в текущем ответе, мс
+	uint32_t txStats[TX_STATS];
+	LzEncoder_t lz;		//!Поток LZ текущего ответа
+	uint64_t lzCycles;	//!Такты сжатия за всё время
+	uint32_t baudRate;	//!Текущая скорость порта
+	uint32_t baudPrev;	//!Скорость до смены, пока хост не подтвердил новую (0 - подтверждена)
+	uint32_t baudDeadline;	//!Срок подтверждения новой скорости, rtos_time_ms
+	char line[COMMAND_LINE_MAX];	//!Накопленная входная строка
+	uint8_t lineLen;
+	uint8_t overflow;	//!Строка длиннее COMMAND_LINE_MAX, отбрасывается до '\n'
+} Link_t;
+static Link_t links[LINKS];
+static uint8_t messType = 0; //!Формат упаковываемого ответа - формат каналов, которым он отправляется
+static uint32_t txLinks = 0; //!Каналы текущего ответа (бит i - канал i)
+static uint8_t replyType = 0; //!Тип кадров текущего ответа - команда, на которую он отправляется
+static CobsEncoder_t cobs; //!Кодер COBS процесса UART
+static Link_t *cobsLink; //!Канал, в очередь которого пишет кодер COBS
+static uint8_t snapshotQueued = 0; //!Рассылка снимка подписчикам стоит в очереди запросов
+static uint32_t calsaveLinks = 0; //!Каналы, ждущие ответа calsave (бит i - канал i)
+static int framesReady = 0; //!Окно повтора кадров запущено (PSRAM есть), иначе frame 1 не принимается
+static int8_t temperatures[SENSORS_MAX] RAM_D_TCM CACHE_ALIGNED; //!Калиброванный снимок
+static int8_t rawValues[SENSORS_MAX] RAM_D_TCM CACHE_ALIGNED; //!Значения после фильтра до калибровки. Шард - строка кэша из SENSORS_SHARD значений
+static int sensorCount = SENSORS_MAX; //!Рабочее количество датчиков
+static uint32_t sampleEpoch = 0; //!Номер опроса датчиков, продолжается после перезагрузки по журналу
+static uint32_t snapshotVersion = 0; //!Меняется (под dataSemaphore) только при изменении снимка или карты карантина, ключ кэша ответов read
+static uint32_t pollTime = 0, publishTime = 0; //!Время по тикам таймера опроса, мс
+static int8_t logSnapshot[SENSORS_MAX]; //!Копия снимка для записи в журнал вне семафора
+static uint8_t txFrame[TX_FRAME_MAX] RAM_D_TCM; //!Буфер упаковки ответа
+static uint8_t lzFrame[CODEC_LZ_MAX(LZ_CHUNK)]; //!Сжатая порция ответа
+static int8_t histChunk[TX_FRAME_MAX / 4]; //!Порция истории датчика для упаковки
+static AggResult_t aggChunk[AGG_CHUNK]; //!Порция агрегатов для упаковки
+static uint32_t acqDone[ACQ_WORKERS]; //!Последний обработанный каждым процессом опроса тик
+static uint32_t acqSet[ACQ_WORKERS][SENSORS_SET_WORDS]; //!Датчики, у которых подошёл срок опроса (у каждого процесса свой диапазон)
+//!Замеры счётчиком тактов (последний проход процесса опроса и последняя упаковка порции ответа)
+uint32_t sampleCycles, encodeCycles;
 /* Private function prototypes -----------------------------------------------*/
 static void timerCallback();
-static void UART_RxCallback();
-static void UART_TxCallback();
+static void UART_EventCallback(int port);
+static int command_byte(Link_t *link, char buff);
 static void UART_Thread();
 static void COMMAND_Thread();
+static void LOG_Thread();
+static void ACQ_Thread(const void *arg);
+static int pack_byte(const int8_t *values, int count, uint8_t *out);
+static int pack_char(const int8_t *values, int count, uint8_t *out);
+static int pack_health(int first, int count, uint8_t *out);
+static void send_read(void);
+static void reply_begin(uint32_t mask, int format);
+static void reply_end(void);
+static int tx_dropping(void);
+static void publish_subscribers(void);
+static void owrom_bind(int sensor, uint64_t rom);
+static void send_list(void);
+static void send_bench(void);
+static void send_counters(const uint32_t *values, int count);
+static void send_baud(Link_t *link, uint32_t rate);
+static long long baud_timeout(void);
+static void baud_fallback(Link_t *link);
+static int baud_switch(Link_t *link, uint32_t rate);
+static void tx_drain(Link_t *link);
+static void send_hist(int sensor, uint32_t count);
+static void send_agg(int window);
+static void send_alarm(int sensor, int state, int value);
+static void send_load(void);
+static void send_bytes(const uint8_t *data, int len);
+static void link_send(Link_t *link, const uint8_t *data, int len);
+static void link_lz(Link_t *link, const uint8_t *data, int len);
+static void link_raw(Link_t *link, const uint8_t *data, int len);
+static void link_queue(Link_t *link, const uint8_t *data, int len);
+static void cobs_queue(const uint8_t *data, int len);
 int sensorsTimer;
-int uartThread, COMMANDThread;
-int uartRxQueue, uartTxQueue, messageQueue;
+int uartThread, COMMANDThread, logThread, acqThread[ACQ_WORKERS];
+int uartRxQueue, messageQueue, logQueue, acqQueue[ACQ_WORKERS];
 int dataSemaphore; //!Для контроля доступа к массиву температур на чтение (для отправки) и запись (по таймеру)
 
 //!Перчисление команд
@@ -47,22 +171,97 @@ enum
 	NO_COMMAND,
 	TOGGLE_COMMAND,
 	READ_COMMAND,
-	MAX_COMMAND
+	HISTORY_COMMAND,
+	HIST_COMMAND,
+	AGG_COMMAND,
+	ALARM_COMMAND,
+	POLL_COMMAND,
+	LOAD_COMMAND,
+	HEALTH_COMMAND,
+	SENSORS_COMMAND,
+	REGISTER_COMMAND,
+	UNREGISTER_COMMAND,
+	LIST_COMMAND,
+	FILTER_COMMAND,
+	BENCH_COMMAND,
+	CAL_COMMAND,
+	CALPOINT_COMMAND,
+	CALSAVE_COMMAND,
+	I2C_COMMAND,
+	OWROM_COMMAND,
+	FRAME_COMMAND,
+	NACK_COMMAND,
+	COBS_COMMAND,
+	BAUD_COMMAND,
+	FLOW_COMMAND,
+	TXSTAT_COMMAND,
+	SUB_COMMAND,
+	CACHE_COMMAND,
+	HUFF_COMMAND,
+	CODEC_COMMAND,
+	LZ_COMMAND,
+	MAX_COMMAND,
+	ALARM_EVENT,	//!Не команда: запрос на отправку кадра тревоги от опроса датчиков
+	SNAPSHOT_EVENT	//!Не команда: рассылка опубликованного снимка подписанным каналам
 }COMMAND_enum;
 
-//!Референсные значения входных команд
-static char COMMANDs[MAX_COMMAND][7] =
+//!Референсные значения входных команд. Аргументы - целые числа через пробел, команда заканчивается '\n'
+static const char *COMMANDs[MAX_COMMAND] =
 {
-		"\0\0\0\0\0\0\0",
-		"toggle\n",
-		"read\n\0\0"
+		"",
+		"toggle",
+		"read",
+		"history",	//!history <from> <to>: кадры журнала с эпохами from..to
+		"hist",		//!hist <sensor> <count>: последние count значений датчика из PSRAM
+		"agg",		//!agg <window>: min/max/среднее/СКО каждого датчика за последние window опросов
+		"alarm",	//!alarm <sensor> <low> <high> <hysteresis>: пороги тревоги датчика
+		"poll",		//!poll <min> <max>: интервал опроса, мс. min == max - фиксированный, иначе адаптивный
+		"load",		//!load: фактическое число чтений датчиков в секунду
+		"health",	//!health <stuck> <jump>: залипание после stuck одинаковых чтений (0 - выкл.), допустимый скачок, °C
+		"sensors",	//!sensors <count>: рабочее количество датчиков, не больше SENSORS_MAX
+		"register",	//!register <id>: добавить устройство с 64-битным ID (десятичный или 0x...) в свободный слот
+		"unregister",	//!unregister <id>: удалить устройство, слот освобождается
+		"list",		//!list: соответствие слотов и ID устройств
+		"filter",	//!filter <shift>: медиана из трёх и среднее с коэффициентом 1 / 2^shift (1..4), 0 - без сглаживания
+		"bench",	//!bench: такты фильтра и калибровки на 256 датчиков, SIMD и скалярная версия
+		"cal",		//!cal <sensor> <gain> <offset> <curve>: коэффициент (1 + gain / 256), смещение offset / 4 °C, кривая 0..4
+		"calpoint",	//!calpoint <curve> <point> <x> <y>: точка кусочно-линейной кривой
+		"calsave",	//!calsave: сохранить калибровку во FLASH
+		"i2c",		//!i2c: замеры последней цепочки чтений датчиков I2C
+		"owrom",	//!owrom <id> <sensor>: ROM-код устройства 1-Wire датчика sensor, 0 - отвязать
+		"frame",	//!frame <mode>: 0 - ответы потоком байт, 1 - кадрами с номером и CRC-32
+		"nack",		//!nack <seq>: повторить кадр с номером seq из окна повтора
+		"cobs",		//!cobs <on>: двоичные ответы (MESS_BYTE и кадры) в COBS с разделителем 0x00
+		"baud",		//!baud <rate>: скорость UART, подтверждается повтором команды на новой скорости
+		"flow",		//!flow <on>: аппаратное управление потоком RTS/CTS
+		"txstat",	//!txstat: ожидание на полной очереди передачи, слитые read, оборванные ответы, замер прерываний порта
+		"sub",		//!sub <on>: присылать каналу каждый опубликованный снимок как ответ read
+		"cache",	//!cache: попадания и промахи кэша ответов read, занято байт
+		"huff",		//!huff <w0> <w1> <w2> <w3>: длины кодов Хаффмана дельта-кадров журнала, по полубайту на символ
+		"codec",	//!codec: замеры кодирования дельта-кадров журнала
+		"lz"		//!lz <on>: каждый ответ каналу - поток LZ (окно 256 байт) с маркером конца
 };
 
-//!Типы ответных сообщений
+//!Количество аргументов команд
+static const uint8_t COMMAND_args[MAX_COMMAND] = { 0, 0, 0, 2, 2, 1, 4, 2, 0, 2, 1, 1, 1, 0, 1, 0, 4, 4, 0, 0, 2, 1, 1, 1, 1, 1, 0, 1, 0, 4, 0, 1 };
+
+//!Запрос процессу UART на формирование ответа
+typedef struct
+{
+	uint8_t command;
+	uint32_t arg[COMMAND_ARGS_MAX];
+	uint64_t id;	//!Первый аргумент целиком (64-битный ID устройства)
+	uint8_t link;	//!Канал, с которого пришла команда
+} Request_t;
+
+static void send_fan_out(const Request_t *request);
+static void send_reply(Link_t *link, const Request_t *request);
+
+//!Типы ответных сообщений. Ответ read идёт порциями по READ_CHUNK датчиков, у каждой порции заголовок с номером первого датчика
 enum
 {
-	MESS_BYTE,	//!Отправляю просто 256 значений температур типа int8_t
-	MESS_CHAR	//!Отправляю 256 строчек по 4 символа со значениями температур типа char[4] ("-012", "+145")
+	MESS_BYTE,	//!Номер первого датчика и количество (uint16_t, little-endian), значения температур типа int8_t, карта карантина
+	MESS_CHAR	//!"@0000 0256\n", строчки по 4 символа со значениями температур типа char[4] ("-012", "+145"), '\n' и карта карантина в hex
 }MESS_enum;
 
 int main(void)
@@ -70,22 +269,69 @@ int main(void)
 
 	//!All init
 	mpu_init();
-	//!Uart init
-	uart_init(UART_RxCallback, UART_TxCallback, &UARTRx_buff, &UARTTx_buff);
+	//!Uart init: по порту на канал. Прерывания будят процесс команд через очередь номеров каналов
+	uartRxQueue = rtos_queue_init(4 * LINKS, sizeof(uint8_t));
+	int l = 0;
+	for (l = 0; l < LINKS; l++)
+	{
+		links[l].port = l;
+		links[l].frameMode = PROTO_RAW;
+		links[l].baudRate = UART_BAUD_DEFAULT;
+		ring_init(&links[l].rx, links[l].rxBuf, LINK_RX_SIZE);
+		ring_init(&links[l].tx, links[l].txBuf, LINK_TX_SIZE);
+		uart_init(l, &links[l].rx, &links[l].tx, UART_EventCallback);
+	}
+	//!Аналоговые датчики: АЦП по таймеру с DMA
+	analog_init();
+	//!Датчики I2C: цепочка чтений по DMA
+	i2ctemp_init();
+	//!Датчики 1-Wire: слоты по таймеру на всех цепочках сразу
+	onewire_init();
 
 	//!Timer init
 	sensorsTimer = rtos_timer_init(1, timerCallback);
-	rtos_timer_start(sensorsTimer, 1000); //!Опрос датчиков раз в секунду
+	poll_configure(1000, 1000, 0); //!По умолчанию опрос всех датчиков раз в секунду
+	rtos_timer_start(sensorsTimer, poll_tick_ms());
 	//!Threads init
 	COMMANDThread = rtos_thread_init(COMMAND_Thread, 0, 128);
-	uartThread 	 = rtos_thread_init(UART_Thread, 0, 128);
+	uartThread 	 = rtos_thread_init(UART_Thread, 0, 256);
+	logThread 	 = rtos_thread_init(LOG_Thread, 0, 256);
+	int w = 0;
+	for (w = 0; w < ACQ_WORKERS; w++)
+	{
+		acqThread[w] = rtos_thread_init_arg(ACQ_Thread, (const void *)(intptr_t)w, 0, 192);
+		acqQueue[w] = rtos_queue_init(2, sizeof(uint32_t));
+	}
 
 	//!Queues init
-	uartRxQueue = rtos_queue_init(10, sizeof(uint8_t));
-	uartTxQueue = rtos_queue_init(1024, sizeof(uint8_t));
-	messageQueue = rtos_queue_init(5, sizeof(uint8_t));
+	messageQueue = rtos_queue_init(16, sizeof(Request_t));
+	logQueue = rtos_queue_init(2, sizeof(uint32_t));
 
 	dataSemaphore = rtos_semaphore_init();
+	//!История значений и реестр устройств в PSRAM
+	histring_init();
+	if (registry_init())
+	{
+		//!ROM-коды, привязанные при старте (имитация цепочек), заносятся в реестр в слоты своих датчиков
+		int s = 0;
+		for (s = ONEWIRE_FIRST; s < ONEWIRE_FIRST + ONEWIRE_SENSORS; s++)
+		{
+			uint64_t rom = 0;
+			if (onewire_rom(s, &rom) && registry_add_at(rom, s) != s)
+			{
+				onewire_bind(s, 0);
+			}
+		}
+	}
+	//!Журнал во FLASH: восстановление после сброса, нумерация опросов продолжается с последнего кадра
+	if (flashlog_init() && flashlog_last_epoch() != FLASHLOG_NONE)
+	{
+		sampleEpoch = flashlog_last_epoch() + 1;
+	}
+	//!Калибровка из последнего сектора FLASH
+	calib_load();
+	//!Кадры ответов: CRC-32 на периферии, окно повтора в PSRAM
+	framesReady = proto_init();
 	/* Start scheduler */
 	rtos_start();
 
@@ -93,154 +339,1310 @@ int main(void)
 
 }
 
-//! Процесс создания сообщения для отправки по UART в заданном формате
+//! Процесс создания сообщения для отправки по UART в заданном формате. Ответ на команду уходит каналу, с которого
+//! она пришла, тревоги и снимки для подписчиков упаковываются один раз на формат и уходят всем каналам с этим форматом
 static void UART_Thread()
 {
-	uint8_t buff;
+	Request_t request;
 	while (1)
 	{
-		//! Использую очередь как евент(флаг), значение буфера не имеет значения
-		if (rtos_queue_receive(messageQueue, &buff, -1))
+		if (rtos_queue_receive(messageQueue, &request, baud_timeout()))
 		{
-			if (rtos_semaphore_take(dataSemaphore, -1))
+			replyType = request.command;
+			if (request.command == ALARM_EVENT || request.command == SNAPSHOT_EVENT)
 			{
+				send_fan_out(&request);
+				continue;
+			}
+			Link_t *link = &links[request.link];
+			reply_begin(1UL << request.link, link->messType);
+			send_reply(link, &request);
+			reply_end();
+		}
+	}
+}
+
+//! Ответ на команду request каналу link
+static void send_reply(Link_t *link, const Request_t *request)
+{
+	if (request->command == BAUD_COMMAND)
+	{
+		send_baud(link, request->arg[0]);
+		return;
+	}
+	if (request->command == FLOW_COMMAND)
+	{
+		tx_drain(link);
+		uart_set_flow(link->port, request->arg[0] != 0);
+		uart_tx_kick(link->port);
+		return;
+	}
+	if (request->command == CALSAVE_COMMAND)
+	{
+		//!Результат записи калибровки от процесса журнала
+		send_counters(&request->arg[0], 1);
+		return;
+	}
+	if (request->command == TXSTAT_COMMAND)
+	{
+		//!Следом за счётчиками канала - замер прерываний порта с прошлого txstat: байт и такты на байт * 10,
+		//!затем такты сжатия LZ на байт * 10
+		uint32_t stats[TX_STATS + 3], bytes = 0, cycles = 0;
+		memcpy(stats, link->txStats, sizeof(link->txStats));
+		uart_isr_stats(link->port, &bytes, &cycles);
+		stats[TX_STATS] = bytes;
+		stats[TX_STATS + 1] = bytes ? (uint32_t)((uint64_t)cycles * 10 / bytes) : 0;
+		stats[TX_STATS + 2] = link->txStats[TX_LZ_IN] ? (uint32_t)(link->lzCycles * 10 / link->txStats[TX_LZ_IN]) : 0;
+		send_counters(stats, TX_STATS + 3);
+		return;
+	}
+	if (request->command == NACK_COMMAND)
+	{
+		const uint8_t *frame = NULL;
+		int size = proto_resend((uint8_t)link->port, (uint16_t)request->arg[0], &frame);
+		if (size)
+		{
+			link_raw(link, frame, size);
+		}
+		else if (link->frameMode == PROTO_FRAMED)
+		{
+			//!Кадр уже вытеснен из окна: ответ nack с его номером, нужен новый запрос
+			uint8_t gone[2] = { (uint8_t)request->arg[0], (uint8_t)(request->arg[0] >> 8) };
+			send_bytes(gone, sizeof(gone));
+		}
+		return;
+	}
+	if (request->command == HISTORY_COMMAND)
+	{
+		//!Кадры журнала отдаются как есть (LogFrame_t + данные) независимо от формата ответа
+		flashlog_history(request->arg[0], request->arg[1], send_bytes);
+		return;
+	}
+	if (request->command == HIST_COMMAND)
+	{
+		send_hist(request->arg[0], request->arg[1]);
+		return;
+	}
+	if (request->command == AGG_COMMAND)
+	{
+		send_agg(request->arg[0]);
+		return;
+	}
+	if (request->command == LOAD_COMMAND)
+	{
+		send_load();
+		return;
+	}
+	if (request->command == LIST_COMMAND)
+	{
+		send_list();
+		return;
+	}
+	if (request->command == BENCH_COMMAND)
+	{
+		send_bench();
+		return;
+	}
+	if (request->command == I2C_COMMAND)
+	{
+		uint32_t stats[I2CTEMP_STATS];
+		i2ctemp_stats(stats);
+		send_counters(stats, I2CTEMP_STATS);
+		return;
+	}
+	if (request->command == CODEC_COMMAND)
+	{
+		uint32_t stats[FLASHLOG_STATS];
+		flashlog_codec_stats(stats);
+		send_counters(stats, FLASHLOG_STATS);
+		return;
+	}
+	if (request->command == CACHE_COMMAND)
+	{
+		uint32_t stats[REPLYCACHE_STATS];
+		replycache_stats(stats);
+		send_counters(stats, REPLYCACHE_STATS);
+		return;
+	}
+	//!read, пришедший с этого момента, встанет в очередь и ответит следующим снимком
+	__atomic_store_n(&link->readQueued, 0, __ATOMIC_RELEASE);
+	send_read();
+}
+
+//! Начало ответа каналам mask в формате format
+static void reply_begin(uint32_t mask, int format)
+{
+	int l = 0;
+	txLinks = mask;
+	messType = (uint8_t)format;
+	for (l = 0; l < LINKS; l++)
+	{
+		if (mask & (1UL << l))
+		{
+			links[l].txStall = 0;
+			links[l].txDropping = 0;
+			codec_lz_begin(&links[l].lz);
+		}
+	}
+}
+
+//! Конец ответа: потоки LZ каналов текущего ответа дописываются до маркера конца. Ответ без данных не сжимается
+static void reply_end(void)
+{
+	int l = 0;
+	for (l = 0; l < LINKS; l++)
+	{
+		Link_t *link = &links[l];
+		if (!(txLinks & (1UL << l)) || !link->lzMode)
+			continue;
+		int size = codec_lz_end(&link->lz, lzFrame);
+		link->txStats[TX_LZ_OUT] += size;
+		if (size)
+		{
+			link_send(link, lzFrame, size);
+		}
+	}
+}
+
+//! Рассылка тревоги (всем каналам) или снимка (подписанным): упаковка один раз на формат
+static void send_fan_out(const Request_t *request)
+{
+	int format = 0, l = 0;
+	if (request->command == SNAPSHOT_EVENT)
+	{
+		//!Снимок подписчику - такой же ответ, как на read
+		replyType = READ_COMMAND;
+		__atomic_store_n(&snapshotQueued, 0, __ATOMIC_RELEASE);
+	}
+	for (format = MESS_BYTE; format <= MESS_CHAR; format++)
+	{
+		uint32_t mask = 0;
+		for (l = 0; l < LINKS; l++)
+		{
+			if (links[l].messType == format && (request->command == ALARM_EVENT || links[l].subscribed))
+			{
+				mask |= 1UL << l;
+			}
+		}
+		if (!mask)
+			continue;
+		reply_begin(mask, format);
+		if (request->command == ALARM_EVENT)
+		{
+			send_alarm(request->arg[0], request->arg[1], (int32_t)request->arg[2]);
+		}
+		else
+		{
+			send_read();
+		}
+		reply_end();
+	}
+}
+
+//! Все каналы текущего ответа обрывают его (очередь передачи стояла дольше TX_STALL_MAX_MS)
+static int tx_dropping(void)
+{
+	int l = 0;
+	for (l = 0; l < LINKS; l++)
+	{
+		if ((txLinks & (1UL << l)) && !links[l].txDropping)
+			return 0;
+	}
+	return 1;
+}
+
+//! Ответ на read: снимок порциями по READ_CHUNK датчиков, без буфера на весь снимок.
+//! Порция, уже упакованная для этой версии снимка в этом формате, берётся из кэша без упаковки
+static void send_read(void)
+{
+	int first = 0;
+	for (first = 0; first < sensorCount && !tx_dropping(); first += READ_CHUNK)
+	{
+		int len = 0;
+		if (rtos_semaphore_take(dataSemaphore, -1))
+		{
+			//!Упаковываю порцию в буфер под семафором, отправляю уже после его освобождения
+			uint32_t start = cycle_counter_get();
+			int count = sensorCount - first < READ_CHUNK ? sensorCount - first : READ_CHUNK;
+			const uint8_t *cached = replycache_find(snapshotVersion, messType, (uint16_t)first, (uint16_t)count, &len);
+			if (cached)
+			{
+				//!Кэш пишет только этот процесс: после семафора порция не изменится
+				rtos_semaphore_give(dataSemaphore);
+				send_bytes(cached, len);
+				continue;
+			}
+			uint8_t *out = txFrame;
+			if (messType == MESS_BYTE)
+			{
+				*out++ = (uint8_t)first;
+				*out++ = (uint8_t)(first >> 8);
+				*out++ = (uint8_t)count;
+				*out++ = (uint8_t)(count >> 8);
+				out += pack_byte(&temperatures[first], count, out);
+			}
+			else
+			{
+				*out++ = '@';
+				*out++ = (uint8_t)((first / 1000 % 10) + 0x30);
+				*out++ = (uint8_t)((first / 100 % 10) + 0x30);
+				*out++ = (uint8_t)((first / 10 % 10) + 0x30);
+				*out++ = (uint8_t)((first % 10) + 0x30);
+				*out++ = ' ';
+				*out++ = (uint8_t)((count / 1000 % 10) + 0x30);
+				*out++ = (uint8_t)((count / 100 % 10) + 0x30);
+				*out++ = (uint8_t)((count / 10 % 10) + 0x30);
+				*out++ = (uint8_t)((count % 10) + 0x30);
+				*out++ = '\n';
+				out += pack_char(&temperatures[first], count, out);
+			}
+			out += pack_health(first, count, out);
+			len = out - txFrame;
+			encodeCycles = cycle_counter_get() - start;
+			replycache_store(snapshotVersion, messType, (uint16_t)first, (uint16_t)count, txFrame, len);
+			rtos_semaphore_give(dataSemaphore);
+		}
+		send_bytes(txFrame, len);
+	}
+}
+
+//! Отправка упакованной части ответа всем каналам текущего ответа
+static void send_bytes(const uint8_t *data, int len)
+{
+	int l = 0;
+	for (l = 0; l < LINKS; l++)
+	{
+		if (!(txLinks & (1UL << l)))
+			continue;
+		if (links[l].lzMode)
+		{
+			link_lz(&links[l], data, len);
+		}
+		else
+		{
+			link_send(&links[l], data, len);
+		}
+	}
+}
+
+//! Сжатие части ответа потоком LZ канала порциями по LZ_CHUNK байт
+static void link_lz(Link_t *link, const uint8_t *data, int len)
+{
+	while (len > 0 && !link->txDropping)
+	{
+		int n = len < LZ_CHUNK ? len : LZ_CHUNK;
+		uint32_t start = cycle_counter_get();
+		int size = codec_lz_put(&link->lz, data, n, lzFrame);
+		link->lzCycles += cycle_counter_get() - start;
+		link->txStats[TX_LZ_IN] += n;
+		link->txStats[TX_LZ_OUT] += size;
+		//!Кодер держит последние байты для поиска повтора, на короткую часть выхода может не быть
+		if (size)
+		{
+			link_send(link, lzFrame, size);
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+//! Отправка части ответа каналу: в режиме PROTO_FRAMED - кадрами не длиннее PROTO_PAYLOAD_MAX с типом replyType
+static void link_send(Link_t *link, const uint8_t *data, int len)
+{
+	if (link->frameMode == PROTO_RAW)
+	{
+		link_raw(link, data, len);
+		return;
+	}
+	while (len > 0)
+	{
+		const uint8_t *frame = NULL;
+		int n = len < PROTO_PAYLOAD_MAX ? len : PROTO_PAYLOAD_MAX;
+		int size = proto_frame((uint8_t)link->port, link->frameSeq, replyType, sampleEpoch, data, n, &frame);
+		if (size)
+		{
+			link->frameSeq++;
+			link_raw(link, frame, size);
+		}
+		else
+		{
+			//!Кадр не построен (окна повтора нет) - часть уходит потоком, а не теряется
+			link_raw(link, data, n);
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+//! Отправка части ответа как есть. Двоичные части в режиме cobs кодируются по пути в очередь,
+//! каждая часть (порция MESS_BYTE или кадр) - отдельный кадр COBS
+static void link_raw(Link_t *link, const uint8_t *data, int len)
+{
+	if (!link->cobsMode || (messType != MESS_BYTE && link->frameMode == PROTO_RAW))
+	{
+		link_queue(link, data, len);
+		return;
+	}
+	cobsLink = link;
+	codec_cobs_begin(&cobs, cobs_queue);
+	codec_cobs_put(&cobs, data, len);
+	codec_cobs_end(&cobs);
+}
+
+static void cobs_queue(const uint8_t *data, int len)
+{
+	link_queue(cobsLink, data, len);
+}
+
+//! Передача байт в очередь обработчика прерываний Tx порта канала. На полной очереди (медленный приёмник, снят CTS)
+//! процесс ждёт, но не дольше TX_STALL_MAX_MS на ответ: дальше остаток ответа каналу отбрасывается, а следующий
+//! read ответит уже свежим снимком. Семафор снимка при этом не занят, опрос датчиков не задерживается
+static void link_queue(Link_t *link, const uint8_t *data, int len)
+{
+	while (len > 0 && !link->txDropping)
+	{
+		int n = ring_write(&link->tx, data, len);
+		data += n;
+		len -= n;
+		if (!len)
+			break;
+		//!Кольцо полно: передатчик стоит (CTS) или не успевает
+		uart_tx_kick(link->port);
+		uint32_t start = rtos_time_ms();
+		rtos_delay(1);
+		link->txStall += rtos_time_ms() - start;
+		link->txStats[TX_STALL_MS] += rtos_time_ms() - start;
+		if (link->txStall >= TX_STALL_MAX_MS)
+		{
+			link->txDropping = 1;
+			link->txStats[TX_DROPPED]++;
+		}
+	}
+	uart_tx_kick(link->port);
+}
+
+//! Упаковка агрегатов MESS_BYTE: min, max (int8_t), среднее (int16_t, Q8), СКО (uint16_t, Q8), little-endian
+static int pack_agg_byte(const AggResult_t *agg, int count, uint8_t *out)
+{
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		*out++ = (uint8_t)agg[i].min;
+		*out++ = (uint8_t)agg[i].max;
+		*out++ = (uint8_t)agg[i].mean;
+		*out++ = (uint8_t)(agg[i].mean >> 8);
+		*out++ = (uint8_t)agg[i].stddev;
+		*out++ = (uint8_t)(agg[i].stddev >> 8);
+	}
+	return count * 6;
+}
+
+//! Число Q8 в виде "+021.50" (со знаком) или "003.25"
+static uint8_t *put_q8(uint8_t *out, int32_t value, int sign)
+{
+	if (sign)
+	{
+		*out++ = value < 0 ? '-' : '+';
+	}
+	if (value < 0)
+	{
+		value = -value;
+	}
+	int32_t whole = value >> AGG_FRAC_BITS;
+	int32_t frac = ((value & ((1 << AGG_FRAC_BITS) - 1)) * 100) >> AGG_FRAC_BITS;
+	*out++ = (uint8_t)((whole / 100 % 10) + 0x30);
+	*out++ = (uint8_t)((whole / 10 % 10) + 0x30);
+	*out++ = (uint8_t)((whole % 10) + 0x30);
+	*out++ = '.';
+	*out++ = (uint8_t)((frac / 10) + 0x30);
+	*out++ = (uint8_t)((frac % 10) + 0x30);
+	return out;
+}
+
+//! Упаковка агрегатов MESS_CHAR: строка на датчик "-012 +035 +021.50 003.25\n"
+static int pack_agg_char(const AggResult_t *agg, int count, uint8_t *out)
+{
+	uint8_t *start = out;
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		int8_t minmax[2] = { agg[i].min, agg[i].max };
+		out += pack_char(minmax, 1, out);
+		*out++ = ' ';
+		out += pack_char(&minmax[1], 1, out);
+		*out++ = ' ';
+		out = put_q8(out, agg[i].mean, 1);
+		*out++ = ' ';
+		out = put_q8(out, agg[i].stddev, 0);
+		*out++ = '\n';
+	}
+	return out - start;
+}
+
+//! Ответ на agg: агрегаты всех датчиков в текущем формате. Смена окна пересобирает агрегаты из последних значений
+static void send_agg(int window)
+{
+	int first = 0;
+	if (rtos_semaphore_take(dataSemaphore, -1))
+	{
+		int ok = agg_set_window(window);
+		rtos_semaphore_give(dataSemaphore);
+		if (!ok)
+			return;
+	}
+	for (first = 0; first < AGG_SENSORS; first += AGG_CHUNK)
+	{
+		int count = AGG_SENSORS - first < AGG_CHUNK ? AGG_SENSORS - first : AGG_CHUNK;
+		if (rtos_semaphore_take(dataSemaphore, -1))
+		{
+			agg_get(first, count, aggChunk);
+			rtos_semaphore_give(dataSemaphore);
+		}
+		int len = messType == MESS_BYTE ? pack_agg_byte(aggChunk, count, txFrame) : pack_agg_char(aggChunk, count, txFrame);
+		send_bytes(txFrame, len);
+	}
+}
+
+//! Кадр тревоги. MESS_BYTE: ALARM_FRAME_MARKER, состояние, номер датчика (uint16_t, little-endian), значение.
+//! MESS_CHAR: "!0123 H +045\n" (N - норма, L - ниже порога, H - выше порога)
+static void send_alarm(int sensor, int state, int value)
+{
+	uint8_t frame[16];
+	uint8_t *out = frame;
+	if (messType == MESS_BYTE)
+	{
+		*out++ = ALARM_FRAME_MARKER;
+		*out++ = (uint8_t)state;
+		*out++ = (uint8_t)sensor;
+		*out++ = (uint8_t)(sensor >> 8);
+		*out++ = (uint8_t)value;
+	}
+	else
+	{
+		int8_t v = (int8_t)value;
+		*out++ = '!';
+		*out++ = (uint8_t)((sensor / 1000 % 10) + 0x30);
+		*out++ = (uint8_t)((sensor / 100 % 10) + 0x30);
+		*out++ = (uint8_t)((sensor / 10 % 10) + 0x30);
+		*out++ = (uint8_t)((sensor % 10) + 0x30);
+		*out++ = ' ';
+		*out++ = state == ALARM_HIGH ? 'H' : state == ALARM_LOW ? 'L' : 'N';
+		*out++ = ' ';
+		out += pack_char(&v, 1, out);
+		*out++ = '\n';
+	}
+	send_bytes(frame, out - frame);
+}
+
+//! Ответ на load: чтений датчиков за последнюю секунду. MESS_BYTE: uint32_t little-endian; MESS_CHAR: "00256\n"
+static void send_load(void)
+{
+	uint8_t frame[8];
+	uint8_t *out = frame;
+	uint32_t load = poll_load();
+	if (messType == MESS_BYTE)
+	{
+		*out++ = (uint8_t)load;
+		*out++ = (uint8_t)(load >> 8);
+		*out++ = (uint8_t)(load >> 16);
+		*out++ = (uint8_t)(load >> 24);
+	}
+	else
+	{
+		*out++ = (uint8_t)((load / 10000 % 10) + 0x30);
+		*out++ = (uint8_t)((load / 1000 % 10) + 0x30);
+		*out++ = (uint8_t)((load / 100 % 10) + 0x30);
+		*out++ = (uint8_t)((load / 10 % 10) + 0x30);
+		*out++ = (uint8_t)((load % 10) + 0x30);
+		*out++ = '\n';
+	}
+	send_bytes(frame, out - frame);
+}
+
+//! Привязка ROM-кода к датчику 1-Wire через реестр (под dataSemaphore): ID в слоте датчика - ROM-код устройства,
+//! onewire.c держит копию для прерывания таймера. ROM-код, привязанный к другому датчику, переходит к этому
+static void owrom_bind(int sensor, uint64_t rom)
+{
+	uint64_t old = 0;
+	if (!onewire_bind(sensor, 0))
+		return;
+	if (registry_id(sensor, &old))
+	{
+		registry_remove(old);
+	}
+	if (rom)
+	{
+		onewire_bind(registry_remove(rom), 0);
+		if (registry_add_at(rom, sensor) == sensor)
+		{
+			onewire_bind(sensor, rom);
+		}
+	}
+}
+
+//! Ответ на list: занятые слоты реестра по возрастанию, порциями по LIST_CHUNK.
+//! MESS_BYTE: слот (uint16_t) и ID (uint64_t), little-endian, в конце слот 0xFFFF; MESS_CHAR: "0003 28FF4A1B0C000012\n", в конце пустая строка
+static void send_list(void)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	int slot = 0;
+	while (slot < REGISTRY_SLOTS)
+	{
+		uint8_t *out = txFrame;
+		int n = 0;
+		if (rtos_semaphore_take(dataSemaphore, -1))
+		{
+			for (; slot < REGISTRY_SLOTS && n < LIST_CHUNK; slot++)
+			{
+				uint64_t id = 0;
+				if (!registry_id(slot, &id))
+					continue;
+				int i = 0;
 				if (messType == MESS_BYTE)
 				{
-					int i = 0;
-					for (i = 0; i < 256; i++)
+					*out++ = (uint8_t)slot;
+					*out++ = (uint8_t)(slot >> 8);
+					for (i = 0; i < 8; i++)
 					{
-						rtos_queue_send(uartTxQueue, &temperatures[i], -1);
+						*out++ = (uint8_t)(id >> (i * 8));
 					}
 				}
 				else
 				{
-					int i = 0;
-					for (i = 0; i < 256; i++)
+					*out++ = (uint8_t)((slot / 1000 % 10) + 0x30);
+					*out++ = (uint8_t)((slot / 100 % 10) + 0x30);
+					*out++ = (uint8_t)((slot / 10 % 10) + 0x30);
+					*out++ = (uint8_t)((slot % 10) + 0x30);
+					*out++ = ' ';
+					for (i = 60; i >= 0; i -= 4)
 					{
-						int8_t temp_t = temperatures[i];
-						char t[4];
-						if (temp_t < 0)
-						{
-							t[0] = '-';
-							temp_t = -temp_t;
-						}
-						else
-						{
-							t[0] = '+';
-						}
-						t[1] = (char)((temp_t / 100) + 0x30);
-						temp_t -= temp_t / 100;
-						t[2] = (char)((temp_t / 10) + 0x30);
-						temp_t -= temp_t / 10;
-						t[3] = (char)(temp_t + 0x30);
-						int j = 0;
-						for (j = 0; j < 4; j++)
-						{
-							rtos_queue_send(uartTxQueue, &t[i], -1);
-						}
+						*out++ = (uint8_t)hex[(id >> i) & 0xF];
+					}
+					*out++ = '\n';
+				}
+				n++;
+			}
+			rtos_semaphore_give(dataSemaphore);
+		}
+		send_bytes(txFrame, out - txFrame);
+	}
+	if (messType == MESS_BYTE)
+	{
+		static const uint8_t end[10] = { 0xFF, 0xFF };
+		send_bytes(end, sizeof(end));
+	}
+	else
+	{
+		send_bytes((const uint8_t *)"\n", 1);
+	}
+}
+
+//! Ответ на bench: такты прохода фильтра по FILTER_BENCH датчикам и калибровки по CALIB_BENCH датчикам,
+//! у каждого SIMD и скалярная версия (SIMD 0 - сборка без DSP)
+static void send_bench(void)
+{
+	uint32_t cycles[4] = { 0, 0, 0, 0 };
+	if (rtos_semaphore_take(dataSemaphore, -1))
+	{
+		filter_bench(&cycles[0], &cycles[1]);
+		calib_bench(&cycles[2], &cycles[3]);
+		rtos_semaphore_give(dataSemaphore);
+	}
+	send_counters(cycles, 4);
+}
+
+//! Смена скорости порта канала (baud <rate>). Ответ - скорость, на которой продолжать: новая, если достижима, иначе текущая.
+//! Ответ уходит на прежней скорости, после его выдачи порт переключается. Хост переходит на новую скорость и за
+//! BAUD_CONFIRM_MS повторяет ту же команду (с '\n' впереди, чтобы сбросить мусор смены скорости) - ответ на повтор
+//! приходит уже на новой скорости. Без повтора порт возвращается к прежней скорости и сообщает её
+static void send_baud(Link_t *link, uint32_t rate)
+{
+	if (link->baudPrev)
+	{
+		//!До подтверждения другая скорость не принимается
+		if (rate == link->baudRate)
+		{
+			link->baudPrev = 0;
+		}
+		send_counters(&link->baudRate, 1);
+		return;
+	}
+	if (rate == link->baudRate || !uart_baud_valid(link->port, rate))
+	{
+		send_counters(&link->baudRate, 1);
+		return;
+	}
+	send_counters(&rate, 1);
+	//!Ответ целиком уходит на прежней скорости
+	reply_end();
+	uint32_t prev = link->baudRate;
+	if (baud_switch(link, rate))
+	{
+		link->baudPrev = prev;
+		link->baudDeadline = rtos_time_ms() + BAUD_CONFIRM_MS;
+	}
+}
+
+//! Ожидание запросов процессом UART: до ближайшего срока подтверждения скорости (-1 - без срока).
+//! Каналы с истёкшим сроком возвращаются к прежней скорости
+static long long baud_timeout(void)
+{
+	long long timeout = -1;
+	int l = 0;
+	for (l = 0; l < LINKS; l++)
+	{
+		if (!links[l].baudPrev)
+			continue;
+		int32_t left = (int32_t)(links[l].baudDeadline - rtos_time_ms());
+		if (left <= 0)
+		{
+			baud_fallback(&links[l]);
+			continue;
+		}
+		if (timeout < 0 || left < timeout)
+		{
+			timeout = left;
+		}
+	}
+	return timeout;
+}
+
+//! Хост не подтвердил новую скорость: возврат к прежней
+static void baud_fallback(Link_t *link)
+{
+	uint32_t prev = link->baudPrev;
+	link->baudPrev = 0;
+	replyType = BAUD_COMMAND;
+	reply_begin(1UL << (link - links), link->messType);
+	baud_switch(link, prev);
+	send_counters(&link->baudRate, 1);
+	reply_end();
+}
+
+//! Переключение порта после выдачи всего, что стоит в очереди передачи канала
+static int baud_switch(Link_t *link, uint32_t rate)
+{
+	tx_drain(link);
+	int ok = uart_set_baud(link->port, rate);
+	uart_tx_kick(link->port);
+	if (!ok)
+		return 0;
+	link->baudRate = rate;
+	return 1;
+}
+
+//! Ожидание выдачи очереди передачи канала перед перенастройкой порта, не дольше BAUD_DRAIN_MS
+static void tx_drain(Link_t *link)
+{
+	uint32_t start = rtos_time_ms();
+	while ((ring_count(&link->tx) || !uart_tx_idle(link->port)) && rtos_time_ms() - start < BAUD_DRAIN_MS)
+	{
+		rtos_delay(1);
+	}
+}
+
+//! Ответ из нескольких счётчиков (не больше 8). MESS_BYTE: uint32_t little-endian; MESS_CHAR: "0000412 0002950\n"
+static void send_counters(const uint32_t *values, int count)
+{
+	uint8_t frame[64];
+	uint8_t *out = frame;
+	int i = 0, j = 0;
+	for (i = 0; i < count; i++)
+	{
+		if (messType == MESS_BYTE)
+		{
+			for (j = 0; j < 4; j++)
+			{
+				*out++ = (uint8_t)(values[i] >> (j * 8));
+			}
+			continue;
+		}
+		uint32_t div = 1000000;
+		for (j = 0; j < 7; j++, div /= 10)
+		{
+			*out++ = (uint8_t)((values[i] / div % 10) + 0x30);
+		}
+		*out++ = i == count - 1 ? '\n' : ' ';
+	}
+	send_bytes(frame, out - frame);
+}
+
+//! Процесс записи снимков в журнал во FLASH. Запись страниц и стирание не задерживают опрос датчиков.
+//! Сохранение калибровки приходит через ту же очередь (FLASHLOG_NONE) и идёт под семафором журнала (flashlog_locked):
+//! QSPI делят этот процесс и процесс UART, читающий кадры для history
+static void LOG_Thread()
+{
+	uint32_t epoch;
+	int count = 0;
+	while (1)
+	{
+		if (rtos_queue_receive(logQueue, &epoch, -1))
+		{
+			if (epoch == FLASHLOG_NONE)
+			{
+				//!Каналы забираются до записи: calsave, пришедший во время записи, получит ответ после следующей
+				uint32_t waiting = __atomic_exchange_n(&calsaveLinks, 0, __ATOMIC_ACQ_REL);
+				Request_t reply = { CALSAVE_COMMAND, { (uint32_t)flashlog_locked(calib_save) } };
+				int l = 0;
+				for (l = 0; l < LINKS; l++)
+				{
+					if (waiting & (1UL << l))
+					{
+						reply.link = (uint8_t)l;
+						rtos_queue_send(messageQueue, &reply, -1);
 					}
 				}
+				continue;
+			}
+			if (rtos_semaphore_take(dataSemaphore, -1))
+			{
+				count = sensorCount;
+				memcpy(logSnapshot, temperatures, count);
 				rtos_semaphore_give(dataSemaphore);
 			}
+			flashlog_append(epoch, logSnapshot, count);
+		}
+	}
+}
+
+//! Упаковка ответа MESS_BYTE: значения типа int8_t
+RAM_I_TCM static int pack_byte(const int8_t *values, int count, uint8_t *out)
+{
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		out[i] = (uint8_t)values[i];
+	}
+	return count;
+}
+
+//! Упаковка ответа MESS_CHAR: значения по 4 символа ("-012", "+145")
+RAM_I_TCM static int pack_char(const int8_t *values, int count, uint8_t *out)
+{
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		int temp_t = values[i];
+		if (temp_t < 0)
+		{
+			out[0] = '-';
+			temp_t = -temp_t;
+		}
+		else
+		{
+			out[0] = '+';
+		}
+		out[1] = (uint8_t)((temp_t / 100) + 0x30);
+		out[2] = (uint8_t)((temp_t / 10 % 10) + 0x30);
+		out[3] = (uint8_t)((temp_t % 10) + 0x30);
+		out += 4;
+	}
+	return count * 4;
+}
+
+//! Карта карантина после значений порции read. MESS_BYTE: (count + 7) / 8 байт (бит i % 8 байта i / 8 - датчик first + i);
+//! MESS_CHAR: '\n', те же байты двумя hex-символами, '\n'. У датчиков в карантине в снимке последнее принятое значение
+static int pack_health(int first, int count, uint8_t *out)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	uint8_t bitmap[READ_CHUNK / 8];
+	int len = health_bitmap(first, count, bitmap);
+	if (messType == MESS_BYTE)
+	{
+		memcpy(out, bitmap, len);
+		return len;
+	}
+	uint8_t *start = out;
+	int i = 0;
+	*out++ = '\n';
+	for (i = 0; i < len; i++)
+	{
+		*out++ = (uint8_t)hex[bitmap[i] >> 4];
+		*out++ = (uint8_t)hex[bitmap[i] & 0xF];
+	}
+	*out++ = '\n';
+	return out - start;
+}
+
+//! Ответ на hist: последние count значений датчика, от старых к новым, в текущем формате.
+//! Читается прямо из кольца в PSRAM без dataSemaphore; если отправка не успевает за записью, ответ обрывается
+static void send_hist(int sensor, uint32_t count)
+{
+	uint32_t head = histring_head();
+	if (count > head)
+		count = head;
+	if (count > HISTRING_DEPTH - HISTRING_GUARD)
+		count = HISTRING_DEPTH - HISTRING_GUARD;
+	uint32_t first = head - count;
+	while (count)
+	{
+		int n = count > sizeof(histChunk) ? sizeof(histChunk) : count;
+		if (!histring_read(sensor, first, n, histChunk))
+			break;
+		int len = messType == MESS_BYTE ? pack_byte(histChunk, n, txFrame) : pack_char(histChunk, n, txFrame);
+		send_bytes(txFrame, len);
+		first += n;
+		count -= n;
+	}
+}
+
+//! Число: десятичное со знаком или шестнадцатеричное с префиксом 0x. Возвращает 0, если числа нет
+static int parse_number(char *str, char **end, uint64_t *value)
+{
+	char *digits = str;
+	while (*digits == ' ')
+	{
+		digits++;
+	}
+	if (digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X'))
+	{
+		digits += 2;
+		*value = strtoull(digits, end, 16);
+	}
+	else
+	{
+		*value = strtoull(digits, end, 10);
+	}
+	if (*end == digits)
+	{
+		*end = str;
+	}
+	return *end != str;
+}
+
+//! Разбор строки команды: имя и целые аргументы через пробел. Возвращает номер команды или NO_COMMAND
+static int parse_command(char *line, Request_t *request)
+{
+	int command = 0;
+	char *args = strchr(line, ' ');
+	if (args)
+	{
+		*args++ = '\0';
+	}
+	for (command = NO_COMMAND + 1; command < MAX_COMMAND; command++)
+	{
+		if (!strcmp(line, COMMANDs[command]))
+			break;
+	}
+	if (command == MAX_COMMAND)
+		return NO_COMMAND;
+
+	int i = 0;
+	for (i = 0; i < COMMAND_args[command]; i++)
+	{
+		char *end = NULL;
+		if (!args)
+			return NO_COMMAND;
+		//!Отрицательные значения (пороги) приходят как uint32_t в дополнительном коде
+		uint64_t value = 0;
+		if (!parse_number(args, &end, &value))
+			return NO_COMMAND;
+		request->arg[i] = (uint32_t)value;
+		if (i == 0)
+		{
+			request->id = value;
 		}
+		args = end;
 	}
+	request->command = (uint8_t)command;
+	return command;
 }
 
-//! Процесс обработки входящих команд
+//! Накопление входного символа канала до '\n'. 1 - строка закончена и лежит в link->line
+static int command_byte(Link_t *link, char buff)
+{
+	if (buff != '\n')
+	{
+		if (link->lineLen < COMMAND_LINE_MAX - 1)
+		{
+			link->line[link->lineLen++] = buff;
+		}
+		else
+		{
+			link->overflow = 1; //!Слишком длинная строка отбрасывается целиком
+		}
+		return 0;
+	}
+	link->line[link->lineLen] = '\0';
+	link->lineLen = 0;
+	if (link->overflow)
+	{
+		link->overflow = 0;
+		return 0;
+	}
+	return 1;
+}
+
+//! Процесс обработки входящих команд всех каналов. У каждого канала своя накапливаемая строка и свои настройки ответов
 static void COMMAND_Thread()
 {
-	uint8_t buff = 0;
-	uint8_t command_status = NO_COMMAND;
-	uint8_t command_counter = 0;
+	uint8_t port = 0, buff = 0;
+	Request_t request;
 	while (1)
 	{
-		if (rtos_queue_receive(uartRxQueue, &buff, -1))
+		if (!rtos_queue_receive(uartRxQueue, &port, -1))
+			continue;
+		Link_t *link = &links[port];
+		while (ring_get(&link->rx, &buff))
 		{
-			//!Чтобы прочитать команды, надо накопить входные символы
-			switch (command_status)
+			if (!command_byte(link, (char)buff))
+				continue;
+			request.link = port;
+			switch (parse_command(link->line, &request))
 			{
-				case NO_COMMAND:
-					if (COMMANDs[TOGGLE_COMMAND][0] == (char)buff)
+				case TOGGLE_COMMAND:
+					link->messType = link->messType == MESS_BYTE ? MESS_CHAR : MESS_BYTE; // messType = (messType + 1) & 0x1;
+					break;
+				case SUB_COMMAND:
+					link->subscribed = request.arg[0] != 0;
+					break;
+				case ALARM_COMMAND:
+					if (rtos_semaphore_take(dataSemaphore, -1))
 					{
-						command_counter++;
-						command_status = TOGGLE_COMMAND;
+						alarm_set(request.arg[0], (int32_t)request.arg[1], (int32_t)request.arg[2], (int32_t)request.arg[3]);
+						rtos_semaphore_give(dataSemaphore);
 					}
-					else if (COMMANDs[READ_COMMAND][0] == (char)buff)
+					break;
+				case POLL_COMMAND:
+					if (rtos_semaphore_take(dataSemaphore, -1))
 					{
-						command_counter++;
-						command_status = READ_COMMAND;
+						int ok = poll_configure(request.arg[0], request.arg[1], pollTime);
+						rtos_semaphore_give(dataSemaphore);
+						if (ok)
+						{
+							rtos_timer_start(sensorsTimer, poll_tick_ms());
+						}
 					}
 					break;
-				case TOGGLE_COMMAND:
-					if (COMMANDs[TOGGLE_COMMAND][command_counter] == '\n' && (char)buff == '\n')
+				case SENSORS_COMMAND:
+					if (request.arg[0] >= 1 && request.arg[0] <= SENSORS_MAX && rtos_semaphore_take(dataSemaphore, -1))
+					{
+						sensorCount = request.arg[0];
+						rtos_semaphore_give(dataSemaphore);
+					}
+					break;
+				case REGISTER_COMMAND:
+				case UNREGISTER_COMMAND:
+					if (rtos_semaphore_take(dataSemaphore, -1))
 					{
-						messType = messType == MESS_BYTE ? MESS_CHAR : MESS_BYTE; // messType = (messType + 1) & 0x1;
-						command_counter = 0;
-						command_status = NO_COMMAND;
+						//!Слот датчика 1-Wire: его ID - ROM-код устройства (для других слотов onewire_bind ничего не делает)
+						if (request.command == REGISTER_COMMAND)
+						{
+							onewire_bind(registry_add(request.id), request.id);
+						}
+						else
+						{
+							onewire_bind(registry_remove(request.id), 0);
+						}
+						rtos_semaphore_give(dataSemaphore);
 					}
-					else if (COMMANDs[TOGGLE_COMMAND][command_counter] == (char)buff)
+					break;
+				case COBS_COMMAND:
+					link->cobsMode = request.arg[0] != 0;
+					break;
+				case LZ_COMMAND:
+					link->lzMode = request.arg[0] != 0;
+					break;
+				case FRAME_COMMAND:
+					if (request.arg[0] == PROTO_RAW || (request.arg[0] == PROTO_FRAMED && framesReady))
 					{
-						command_counter++;
-						command_status = TOGGLE_COMMAND;
+						link->frameMode = (uint8_t)request.arg[0];
 					}
-					else
+					break;
+				case OWROM_COMMAND:
+					if (rtos_semaphore_take(dataSemaphore, -1))
 					{
-						command_counter = 0;
-						command_status = NO_COMMAND;
+						owrom_bind(request.arg[1], request.id);
+						rtos_semaphore_give(dataSemaphore);
 					}
 					break;
-				case READ_COMMAND:
-					if (COMMANDs[READ_COMMAND][command_counter] == '\n' && (char)buff == '\n')
+				case CAL_COMMAND:
+				case CALPOINT_COMMAND:
+					if (rtos_semaphore_take(dataSemaphore, -1))
+					{
+						if (request.command == CAL_COMMAND)
+						{
+							calib_set(request.arg[0], (int32_t)request.arg[1], (int32_t)request.arg[2], request.arg[3]);
+						}
+						else
+						{
+							calib_point(request.arg[0], request.arg[1], (int32_t)request.arg[2], (int32_t)request.arg[3]);
+						}
+						rtos_semaphore_give(dataSemaphore);
+					}
+					break;
+				case HUFF_COMMAND:
+				{
+					//!Символ s - полубайт s % 8 (младший первым) аргумента s / 8
+					uint8_t lengths[CODEC_HUFF_SYMBOLS];
+					int s = 0;
+					for (s = 0; s < CODEC_HUFF_SYMBOLS; s++)
 					{
-						command_counter = 0;
-						command_status = NO_COMMAND;
-						//! Использую очередь как евент(флаг), значение буфера не имеет значения
-						rtos_queue_send(messageQueue, &buff, -1);
+						lengths[s] = (uint8_t)((request.arg[s / 8] >> (s % 8 * 4)) & 0x0F);
 					}
-					else if (COMMANDs[READ_COMMAND][command_counter] == (char)buff)
+					//!Отвергнутая таблица (длины не задают префиксный код) выключает код, а не оставляет прежний:
+					//!"codec" покажет метку 0, и хост увидит, что загрузка не удалась
+					if (!flashlog_huff_set(lengths))
 					{
-						command_counter++;
-						command_status = READ_COMMAND;
+						memset(lengths, 0, sizeof(lengths));
+						flashlog_huff_set(lengths);
 					}
-					else
+					break;
+				}
+				case CALSAVE_COMMAND:
+				{
+					//!Ответ (1 - сохранено, 0 - ошибка записи) пришлёт процесс журнала после записи
+					uint32_t save = FLASHLOG_NONE;
+					__atomic_fetch_or(&calsaveLinks, 1UL << request.link, __ATOMIC_RELEASE);
+					rtos_queue_send(logQueue, &save, -1);
+					break;
+				}
+				case FILTER_COMMAND:
+					if (rtos_semaphore_take(dataSemaphore, -1))
 					{
-						command_counter = 0;
-						command_status = NO_COMMAND;
+						filter_set(request.arg[0]);
+						rtos_semaphore_give(dataSemaphore);
 					}
 					break;
-
+				case HEALTH_COMMAND:
+					if (rtos_semaphore_take(dataSemaphore, -1))
+					{
+						health_set(request.arg[0], request.arg[1]);
+						rtos_semaphore_give(dataSemaphore);
+					}
+					break;
+				case READ_COMMAND:
+					//!Ещё не взятый в работу read ответит самым свежим снимком: второй в очередь не ставится
+					if (__atomic_exchange_n(&link->readQueued, 1, __ATOMIC_ACQ_REL))
+					{
+						link->txStats[TX_COALESCED]++;
+						break;
+					}
+					rtos_queue_send(messageQueue, &request, -1);
+					break;
+				case HISTORY_COMMAND:
+				case HIST_COMMAND:
+				case AGG_COMMAND:
+				case LOAD_COMMAND:
+				case LIST_COMMAND:
+				case BENCH_COMMAND:
+				case I2C_COMMAND:
+				case NACK_COMMAND:
+				case BAUD_COMMAND:
+				case FLOW_COMMAND:
+				case TXSTAT_COMMAND:
+				case CACHE_COMMAND:
+				case CODEC_COMMAND:
+					rtos_queue_send(messageQueue, &request, -1);
+					break;
+				default:
+					break;
 			}
 		}
 	}
 }
 
-//! Обработчик прерывания таймера. Поулчаем значения температур от датчиков
-static void timerCallback()
+//! Обработчик прерывания таймера. Таймер тикает с минимальным интервалом опроса и раздаёт тик процессам опроса
+RAM_I_TCM static void timerCallback()
 {
-	if (rtos_semaphore_take(dataSemaphore, -1))
+	pollTime += poll_tick_ms();
+	int w = 0;
+	for (w = 0; w < ACQ_WORKERS; w++)
 	{
-		int i = 0;
-		for (i = 0; i < 256; i ++)
+		//!Если процесс ещё занят прошлыми тиками, этот тик он пропустит
+		rtos_queue_send(acqQueue[w], &pollTime, 0);
+	}
+}
+
+//! Фиксация прочитанного шарда (под dataSemaphore): контроль исправности, сглаживание, срок следующего чтения,
+//! запись в rawValues. values и status - буферы на SENSORS_SHARD датчиков
+RAM_I_TCM static void acquire_commit(int first, int count, uint32_t now, int8_t *values, const uint8_t *status)
+{
+	uint8_t accepted[SENSORS_SHARD];
+	int i = 0, modified = 0;
+	memset(accepted, 0, sizeof(accepted));
+	//!Значение неисправного датчика в снимок и в фильтр не попадает, остаётся последнее принятое
+	for (i = 0; i < count; i++)
+	{
+		if (status[i] == SENSOR_SKIP)
+			continue;
+		int quarantined = health_quarantined(first + i);
+		if (health_check(first + i, status[i] == SENSOR_OK, values[i], rawValues[first + i]))
 		{
-			temperatures[i] = get_temperature(i);
+			accepted[i] = 0xFF;
 		}
-		rtos_semaphore_give(dataSemaphore);
+		modified |= quarantined != health_quarantined(first + i);
+	}
+	filter_run(first, count, values, accepted);
+	for (i = 0; i < count; i++)
+	{
+		int sensor = first + i;
+		int changed = 0;
+		if (status[i] == SENSOR_SKIP)
+			continue;
+		if (accepted[i])
+		{
+			changed = values[i] != rawValues[sensor];
+			rawValues[sensor] = values[i];
+		}
+		modified |= changed;
+		if (health_quarantined(sensor))
+		{
+			poll_defer(sensor, now, health_backoff(sensor));
+		}
+		else
+		{
+			poll_done(sensor, now, changed);
+		}
+	}
+	//!Прочитанные значения и карантин те же: кэш ответов read остаётся в силе
+	if (modified)
+	{
+		snapshotVersion++;
 	}
 }
 
-//! Обработчик прерывания UART. Получаем команды
-static void UART_RxCallback()
+//! Процесс опроса датчиков. Каждый процесс опрашивает свой непрерывный диапазон шардов: собирает набор датчиков,
+//! у которых подошёл срок, запускает по нему преобразование на всех шинах сразу, ждёт готовности шин (не дольше тика)
+//! и читает шарды пакетно через драйверы. Чтение идёт без семафора, под семафором фиксируется шард целиком.
+//! Последний закончивший тик процесс калибрует снимок (rawValues -> temperatures), проверяет тревоги
+//! и раз в poll_publish_ms() публикует снимок (история, агрегаты, журнал, эпоха)
+static void ACQ_Thread(const void *arg)
 {
-	uint8_t buff = UARTRx_buff;
-	rtos_queue_send(uartRxQueue, &buff, 1);
+	int worker = (int)(intptr_t)arg;
+	uint32_t now;
+	int8_t values[SENSORS_SHARD];
+	uint8_t status[SENSORS_SHARD];
+	AlarmEvent_t events[ALARM_EVENTS_MAX];
+	while (1)
+	{
+		if (!rtos_queue_receive(acqQueue[worker], &now, -1))
+			continue;
+		uint32_t start = cycle_counter_get();
+		int count = sensorCount;
+		int shards = (count + SENSORS_SHARD - 1) / SENSORS_SHARD;
+		int shard = shards * worker / ACQ_WORKERS;
+		int last = shards * (worker + 1) / ACQ_WORKERS;
+		int from = shard * SENSORS_SHARD;
+		int to = last * SENSORS_SHARD < count ? last * SENSORS_SHARD : count;
+		uint32_t *set = acqSet[worker];
+		int i = 0, due = 0;
+		//!Диапазон выровнен по шарду, а значит и по слову набора
+		for (i = from; i < to; i += 32)
+		{
+			set[i / 32] = 0;
+		}
+		for (i = from; i < to; i++)
+		{
+			if (poll_is_due(i, now))
+			{
+				set[i / 32] |= 1UL << (i % 32);
+				due = 1;
+			}
+		}
+		if (due)
+		{
+			int wait = poll_tick_ms();
+			sensors_begin(set, from, to - from);
+			//!Не дождавшиеся шины I2C отдадут при чтении ошибку. Устройства 1-Wire посреди цикла (преобразование
+			//!дольше тика) отдаются как не опрошенные и остаются в наборе следующих тиков
+			while (!sensors_ready(from, to - from) && wait-- > 0)
+			{
+				rtos_delay(1);
+			}
+		}
+		for (; due && shard < last; shard++)
+		{
+			int first = shard * SENSORS_SHARD;
+			int n = count - first < SENSORS_SHARD ? count - first : SENSORS_SHARD;
+			sensors_read(first, n, values, status);
+			for (i = 0; i < n; i++)
+			{
+				if (!(set[(first + i) / 32] & (1UL << ((first + i) % 32))))
+				{
+					status[i] = SENSOR_SKIP;
+				}
+			}
+			if (rtos_semaphore_take(dataSemaphore, -1))
+			{
+				acquire_commit(first, n, now, values, status);
+				rtos_semaphore_give(dataSemaphore);
+			}
+		}
+		sampleCycles = cycle_counter_get() - start;
+
+		int alarms = 0, publish = 0, done = 1;
+		uint32_t epoch = 0;
+		if (rtos_semaphore_take(dataSemaphore, -1))
+		{
+			acqDone[worker] = now;
+			int w = 0;
+			for (w = 0; w < ACQ_WORKERS; w++)
+			{
+				done &= acqDone[w] == now;
+			}
+			if (done)
+			{
+				poll_tick(now);
+				//!Калибровка всего снимка одним проходом, версия меняется только если снимок стал другим
+				if (calib_apply(rawValues, temperatures, sensorCount))
+				{
+					snapshotVersion++;
+				}
+				alarms = alarm_check(temperatures, events);
+				publish = now - publishTime >= (uint32_t)poll_publish_ms();
+				epoch = sampleEpoch;
+				if (publish)
+				{
+					publishTime = now;
+					histring_append(temperatures);
+					agg_update(temperatures);
+					sampleEpoch++;
+				}
+			}
+			rtos_semaphore_give(dataSemaphore);
+		}
+		//!Тревоги встают в начало очереди запросов, впереди ожидающих read. В обратном порядке, чтобы сохранить очерёдность.
+		//!Очередь полна - переход отменяется и будет найден и отправлен на следующем тике, а не теряется
+		while (alarms--)
+		{
+			Request_t alarm = { ALARM_EVENT, { events[alarms].sensor, events[alarms].state, (uint32_t)events[alarms].value } };
+			if (!rtos_queue_send_front(messageQueue, &alarm, 0) && rtos_semaphore_take(dataSemaphore, -1))
+			{
+				alarm_revert(&events[alarms]);
+				rtos_semaphore_give(dataSemaphore);
+			}
+		}
+		//!Если процесс журнала не успевает (стирание FLASH), снимок в журнал не попадает
+		if (publish)
+		{
+			rtos_queue_send(logQueue, &epoch, 0);
+			publish_subscribers();
+		}
+	}
 }
 
-//! Обработчик прерывания UART. Отправляем данные
-static void UART_TxCallback()
+//! Рассылка опубликованного снимка подписанным каналам. Пока прошлая рассылка не взята процессом UART, новая не
+//! ставится: она и так отправит самый свежий снимок. Очередь запросов полна - снимок подписчикам не уходит
+static void publish_subscribers(void)
 {
-	uint8_t buff = 0;
-	if (rtos_queue_receive(uartTxQueue, &buff, 1))
+	int l = 0, any = 0;
+	for (l = 0; l < LINKS; l++)
+	{
+		any |= links[l].subscribed;
+	}
+	if (!any || __atomic_exchange_n(&snapshotQueued, 1, __ATOMIC_ACQ_REL))
+		return;
+	Request_t snapshot = { SNAPSHOT_EVENT };
+	if (!rtos_queue_send(messageQueue, &snapshot, 0))
 	{
-		UARTTx_buff = buff;
+		__atomic_store_n(&snapshotQueued, 0, __ATOMIC_RELEASE);
 	}
 }
+
+//! Обработчик прерывания UART: в кольце приёма канала есть строка (или оно заполнено наполовину)
+RAM_I_TCM static void UART_EventCallback(int port)
+{
+	uint8_t link = (uint8_t)port;
+	rtos_queue_send_isr(uartRxQueue, &link);
+}
@@ -8,20 +8,57 @@
 #include "mpuinit.h"
 #include <stdlib.h>
 
-static void(*uart_RxCallBack_func)(void);
-static void(*uart_TxCallBack_func)(void);
+static void(*uart_Event_func)(int port);
+static Ring_t *uartRxRing[UART_PORTS];
+static Ring_t *uartTxRing[UART_PORTS];
+static uint32_t uartIsrCycles[UART_PORTS], uartIsrBytes[UART_PORTS];
+static void(*adc_CallBack_func)(int half);
+static void(*i2c_CallBack_func)(int error);
+static void(*ow_CallBack_func)(void);
 
 #ifdef STM32_BUILD
 #include "stm32f7xx_hal.h"
 #include "stm32f723e_discovery.h"
+#include "stm32f723e_discovery_qspi.h"
+#include "stm32f723e_discovery_psram.h"
 
 static void MPU_Config(void);
 static void SystemClock_Config(void);
 static void CPU_CACHE_Enable(void);
+static int uart_rx_start(int port);
 
-UART_HandleTypeDef UartHandle;
-uint8_t *UARTTx;
-uint8_t *UARTRx;
+UART_HandleTypeDef UartHandle[UART_PORTS];
+#if UART_LL
+#include "stm32f7xx_ll_usart.h"
+#else
+static uint8_t uartRxByte[UART_PORTS];	//!Буферы байта для HAL_UART_Receive_IT / HAL_UART_Transmit_IT
+static uint8_t uartTxByte[UART_PORTS];
+#endif
+//!Порты: UART4 - разъём (PH13/PH14), USART6 - виртуальный COM-порт ST-LINK (PC6/PC7), USART2 - PA2/PA3
+static const struct
+{
+	USART_TypeDef *instance;
+	GPIO_TypeDef *gpio;
+	uint16_t pins;
+	uint8_t af;
+	IRQn_Type irq;
+} uartPorts[UART_PORTS] =
+{
+	{ UART4, GPIOH, GPIO_PIN_13 | GPIO_PIN_14, GPIO_AF8_UART4, UART4_IRQn },
+	{ USART6, GPIOC, GPIO_PIN_6 | GPIO_PIN_7, GPIO_AF8_USART6, USART6_IRQn },
+	{ USART2, GPIOA, GPIO_PIN_2 | GPIO_PIN_3, GPIO_AF7_USART2, USART2_IRQn }
+};
+ADC_HandleTypeDef AdcHandle;
+DMA_HandleTypeDef AdcDmaHandle;
+TIM_HandleTypeDef AdcTimHandle;
+I2C_HandleTypeDef I2cHandle;
+DMA_HandleTypeDef I2cDmaHandle;
+//!TIMINGR для 400 кГц от PCLK1 = 54 МГц: PRESC 5 (9 МГц), SCLDEL 3, SDADEL 1, SCLH 6, SCLL 12
+#define I2C_TIMING_400K		0x5031060C
+TIM_HandleTypeDef OwTimHandle;
+CRC_HandleTypeDef CrcHandle;
+static const uint16_t owPins[4] = { GPIO_PIN_14, GPIO_PIN_15, GPIO_PIN_4, GPIO_PIN_7 };
+static int owChains = 0;
 #else
 //!Different init functions
 #endif
@@ -52,35 +89,639 @@ void mpu_init()
 	  SystemClock_Config();
 #else
 	  //!Different init functions
+#endif
+	  cycle_counter_init();
+}
+
+void cycle_counter_init(void)
+{
+#ifdef STM32_BUILD
+	  /* Enable the DWT unit and start the cycle counter */
+	  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	  DWT->LAR = 0xC5ACCE55;
+	  DWT->CYCCNT = 0;
+	  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#else
+	  //!Different init functions
+#endif
+}
+
+uint32_t cycle_counter_get(void)
+{
+#ifdef STM32_BUILD
+	return DWT->CYCCNT;
+#else
+	return 0;
+#endif
+}
+
+int qspi_init(void)
+{
+#ifdef STM32_BUILD
+	return BSP_QSPI_Init() == QSPI_OK;
+#else
+	//!Different init functions
+	return 0;
+#endif
+}
+
+int qspi_read(uint32_t addr, void *data, uint32_t size)
+{
+#ifdef STM32_BUILD
+	return BSP_QSPI_Read((uint8_t *)data, addr, size) == QSPI_OK;
+#else
+	//!Different init functions
+	return 0;
+#endif
+}
+
+int qspi_write(uint32_t addr, const void *data, uint32_t size)
+{
+#ifdef STM32_BUILD
+	return BSP_QSPI_Write((uint8_t *)data, addr, size) == QSPI_OK;
+#else
+	//!Different init functions
+	return 0;
+#endif
+}
+
+//!Стирает блок QSPI_ERASE_SIZE, содержащий addr
+int qspi_erase(uint32_t addr)
+{
+#ifdef STM32_BUILD
+	return BSP_QSPI_Erase_Block(addr) == QSPI_OK;
+#else
+	//!Different init functions
+	return 0;
+#endif
+}
+
+//!Повторный вызов не переинициализирует FMC
+void *psram_init(uint32_t *size)
+{
+#ifdef STM32_BUILD
+	static int ready = 0;
+	if (!ready && BSP_PSRAM_Init() != PSRAM_OK)
+	{
+		*size = 0;
+		return NULL;
+	}
+	ready = 1;
+	*size = PSRAM_DEVICE_SIZE;
+	return (void *)PSRAM_DEVICE_ADDR;
+#else
+	//!Different init functions
+	*size = 0;
+	return NULL;
+#endif
+}
+
+//!Таблицы RAM_EXT: на STM32 лежат в PSRAM, без неё недоступны
+int ram_ext_init(void)
+{
+#ifdef STM32_BUILD
+	uint32_t size = 0;
+	return psram_init(&size) != NULL;
+#else
+	//!Different init functions
+	return 1;
+#endif
+}
+
+//!Диапазон расширяется до границ строк кэша
+void cache_clean(const void *addr, uint32_t size)
+{
+#ifdef STM32_BUILD
+	uint32_t start = (uint32_t)addr & ~(uint32_t)(CACHE_LINE_SIZE - 1);
+	uint32_t end = ((uint32_t)addr + size + CACHE_LINE_SIZE - 1) & ~(uint32_t)(CACHE_LINE_SIZE - 1);
+	SCB_CleanDCache_by_Addr((uint32_t *)start, (int32_t)(end - start));
+#else
+	//!Different init functions
 #endif
 }
 
-void uart_init(void (*uart_RxCallBack)(void), void (*uart_TxCallBack)(void), uint8_t *Rx, uint8_t *Tx)
+void cache_invalidate(void *addr, uint32_t size)
 {
+#ifdef STM32_BUILD
+	uint32_t start = (uint32_t)addr & ~(uint32_t)(CACHE_LINE_SIZE - 1);
+	uint32_t end = ((uint32_t)addr + size + CACHE_LINE_SIZE - 1) & ~(uint32_t)(CACHE_LINE_SIZE - 1);
+	SCB_InvalidateDCache_by_Addr((uint32_t *)start, (int32_t)(end - start));
+#else
+	//!Different init functions
+#endif
+}
+
+void uart_init(int port, Ring_t *rx, Ring_t *tx, void (*uart_Event)(int port))
+{
+	  uart_Event_func = uart_Event;
+	  uartRxRing[port] = rx;
+	  uartTxRing[port] = tx;
 
 #ifdef STM32_BUILD
-	  UartHandle.Instance				= UART4;
-	  UartHandle.Init.BaudRate			= 115200;
-	  UartHandle.Init.Mode 				= UART_MODE_TX_RX;
-	  UartHandle.Init.Parity 			= UART_PARITY_NONE;
-	  UartHandle.Init.StopBits 			= UART_STOPBITS_1;
-	  UartHandle.Init.WordLength 		= UART_WORDLENGTH_8B;
-	  UARTTx = Tx;
-	  UARTRx = Rx;
+	  GPIO_InitTypeDef gpio = { 0 };
+	  UART_HandleTypeDef *huart = &UartHandle[port];
 
-	  if(HAL_UART_Transmit_IT(&UartHandle, UARTTx, sizeof(uint8_t)) != HAL_OK)
+	  switch (port)
+	  {
+	  case 0:
+		  __HAL_RCC_GPIOH_CLK_ENABLE();
+		  __HAL_RCC_UART4_CLK_ENABLE();
+		  break;
+	  case 1:
+		  __HAL_RCC_GPIOC_CLK_ENABLE();
+		  __HAL_RCC_USART6_CLK_ENABLE();
+		  break;
+	  default:
+		  __HAL_RCC_GPIOA_CLK_ENABLE();
+		  __HAL_RCC_USART2_CLK_ENABLE();
+		  break;
+	  }
+
+	  gpio.Pin = uartPorts[port].pins;
+	  gpio.Mode = GPIO_MODE_AF_PP;
+	  gpio.Pull = GPIO_PULLUP;
+	  gpio.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+	  gpio.Alternate = uartPorts[port].af;
+	  HAL_GPIO_Init(uartPorts[port].gpio, &gpio);
+
+	  huart->Instance				= uartPorts[port].instance;
+	  huart->Init.BaudRate			= UART_BAUD_DEFAULT;
+	  huart->Init.Mode 				= UART_MODE_TX_RX;
+	  huart->Init.Parity 			= UART_PARITY_NONE;
+	  huart->Init.StopBits 			= UART_STOPBITS_1;
+	  huart->Init.WordLength 		= UART_WORDLENGTH_8B;
+	  huart->Init.HwFlowCtl			= UART_HWCONTROL_NONE;
+	  huart->Init.OverSampling		= UART_OVERSAMPLING_16;
+	  huart->Init.OneBitSampling	= UART_ONE_BIT_SAMPLE_DISABLE;
+	  if(HAL_UART_Init(huart) != HAL_OK)
 	  {
 		  exit(1);
 	  }
-	  if(HAL_UART_Receive_IT(&UartHandle, UARTRx, sizeof(uint8_t)) != HAL_OK)
+	  HAL_NVIC_SetPriority(uartPorts[port].irq, 6, 0);
+	  HAL_NVIC_EnableIRQ(uartPorts[port].irq);
+
+	  if(!uart_rx_start(port))
 	  {
 		  exit(1);
 	  }
 #else
 	  //!Different init functions
 #endif
-	  uart_RxCallBack_func = uart_RxCallBack;
-	  uart_TxCallBack_func = uart_TxCallBack;
+}
+
+//! Делитель порта (USARTDIV) для скорости baud, 0 - недостижима. При передискретизации 8 USARTDIV = 2 * PCLK / baud
+static uint32_t uart_divider(int port, uint32_t baud, int *over8)
+{
+#ifdef STM32_BUILD
+	//!USART6 на APB2 (108 МГц), остальные на APB1 (54 МГц)
+	uint32_t pclk = port == 1 ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+#else
+	uint32_t pclk = port == 1 ? 108000000 : 54000000;
+#endif
+	uint32_t div = 0, actual = 0, error = 0;
+	if (baud == 0)
+		return 0;
+	*over8 = 0;
+	div = (pclk + baud / 2) / baud;
+	if (div > 0xFFFF)
+		return 0;
+	if (div < 16)
+	{
+		*over8 = 1;
+		div = (2 * pclk + baud / 2) / baud;
+		if (div < 16)
+			return 0;
+		actual = 2 * pclk / div;
+	}
+	else
+	{
+		actual = pclk / div;
+	}
+	error = actual > baud ? actual - baud : baud - actual;
+	if ((uint64_t)error * 1000 > (uint64_t)baud * UART_BAUD_ERROR_PERMILLE)
+		return 0;
+	return div;
+}
+
+#ifdef STM32_BUILD
+//! Перезапуск порта с настройками из UartHandle.Init. Передача и приём в процессе обрываются, приём запускается заново,
+//! передача продолжается из кольца по uart_tx_kick
+static int uart_restart(int port)
+{
+	HAL_UART_Abort(&UartHandle[port]);
+	if (HAL_UART_Init(&UartHandle[port]) != HAL_OK)
+		return 0;
+	return uart_rx_start(port);
+}
+#endif
+
+int uart_baud_valid(int port, uint32_t baud)
+{
+	int over8 = 0;
+	return uart_divider(port, baud, &over8) != 0;
+}
+
+//! Перезапуск порта на новой скорости
+int uart_set_baud(int port, uint32_t baud)
+{
+	int over8 = 0;
+	if (!uart_divider(port, baud, &over8))
+		return 0;
+#ifdef STM32_BUILD
+	UartHandle[port].Init.BaudRate = baud;
+	UartHandle[port].Init.OverSampling = over8 ? UART_OVERSAMPLING_8 : UART_OVERSAMPLING_16;
+	return uart_restart(port);
+#else
+	//!Different init functions
+	return 1;
+#endif
+}
+
+//! RTS/CTS на UART4: CTS - PB0, RTS - PA15. При снятом CTS передатчик стоит после текущего байта,
+//! RTS снимается, пока принятый байт не забран из RDR
+int uart_set_flow(int port, int on)
+{
+	if (port != 0)
+		return 0;
+#ifdef STM32_BUILD
+	GPIO_InitTypeDef gpio = { 0 };
+
+	if (on)
+	{
+		__HAL_RCC_GPIOA_CLK_ENABLE();
+		__HAL_RCC_GPIOB_CLK_ENABLE();
+		gpio.Mode = GPIO_MODE_AF_PP;
+		gpio.Pull = GPIO_PULLUP;
+		gpio.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+		gpio.Alternate = GPIO_AF8_UART4;
+		gpio.Pin = GPIO_PIN_0;
+		HAL_GPIO_Init(GPIOB, &gpio);
+		gpio.Pin = GPIO_PIN_15;
+		HAL_GPIO_Init(GPIOA, &gpio);
+	}
+	UartHandle[port].Init.HwFlowCtl = on ? UART_HWCONTROL_RTS_CTS : UART_HWCONTROL_NONE;
+	return uart_restart(port);
+#else
+	//!Different init functions
+	(void)on;
+	return 1;
+#endif
+}
+
+//! Запуск передачи из кольца, если передатчик стоит. Дальше байты подбирает прерывание
+void uart_tx_kick(int port)
+{
+#ifdef STM32_BUILD
+#if UART_LL
+	//!Прерывание TXE само снимет разрешение, когда кольцо опустеет
+	LL_USART_EnableIT_TXE(uartPorts[port].instance);
+#else
+	HAL_NVIC_DisableIRQ(uartPorts[port].irq);
+	if (UartHandle[port].gState == HAL_UART_STATE_READY && ring_get(uartTxRing[port], &uartTxByte[port]))
+	{
+		HAL_UART_Transmit_IT(&UartHandle[port], &uartTxByte[port], sizeof(uint8_t));
+	}
+	HAL_NVIC_EnableIRQ(uartPorts[port].irq);
+#endif
+#else
+	//!Different init functions
+	(void)port;
+#endif
+}
+
+int uart_tx_idle(int port)
+{
+#ifdef STM32_BUILD
+#if UART_LL
+	return !LL_USART_IsEnabledIT_TXE(uartPorts[port].instance) && LL_USART_IsActiveFlag_TC(uartPorts[port].instance);
+#else
+	return UartHandle[port].gState == HAL_UART_STATE_READY && __HAL_UART_GET_FLAG(&UartHandle[port], UART_FLAG_TC);
+#endif
+#else
+	(void)port;
+	return 1;
+#endif
+}
+
+//! Замеры прерываний порта с прошлого вызова: перенесено байт (приём и передача) и такты в обработчике
+void uart_isr_stats(int port, uint32_t *bytes, uint32_t *cycles)
+{
+	*bytes = __atomic_exchange_n(&uartIsrBytes[port], 0, __ATOMIC_ACQ_REL);
+	*cycles = __atomic_exchange_n(&uartIsrCycles[port], 0, __ATOMIC_ACQ_REL);
+}
+
+#ifdef STM32_BUILD
+//! Принятый байт в кольцо. Процесс будится только в конце строки и при заполнении кольца наполовину
+RAM_I_TCM static void uart_rx_byte(int port, uint8_t data)
+{
+	Ring_t *rx = uartRxRing[port];
+	if (ring_put(rx, data) && (data == '\n' || ring_count(rx) == (rx->mask + 1) / 2))
+	{
+		uart_Event_func(port);
+	}
+}
+
+//! Разрешение приёма: на LL - прерывания RXNE и ошибок, на HAL - приём одного байта по прерыванию
+static int uart_rx_start(int port)
+{
+#if UART_LL
+	LL_USART_EnableIT_RXNE(uartPorts[port].instance);
+	LL_USART_EnableIT_ERROR(uartPorts[port].instance);
+	return 1;
+#else
+	return HAL_UART_Receive_IT(&UartHandle[port], &uartRxByte[port], sizeof(uint8_t)) == HAL_OK;
+#endif
+}
+#endif
+
+int adc_scan_init(const uint8_t *channels, int count, uint16_t *buffer, int length, int rateHz, void (*adc_CallBack)(int half))
+{
+	adc_CallBack_func = adc_CallBack;
+#ifdef STM32_BUILD
+	//!Выводы входов ADC1: IN0..7 - PA0..7, IN8..9 - PB0..1, IN10..15 - PC0..5
+	static GPIO_TypeDef *const ports[16] = { GPIOA, GPIOA, GPIOA, GPIOA, GPIOA, GPIOA, GPIOA, GPIOA,
+			GPIOB, GPIOB, GPIOC, GPIOC, GPIOC, GPIOC, GPIOC, GPIOC };
+	static const uint8_t pins[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 0, 1, 2, 3, 4, 5 };
+	GPIO_InitTypeDef gpio = { 0 };
+	ADC_ChannelConfTypeDef channel = { 0 };
+	TIM_MasterConfigTypeDef master = { 0 };
+	int i = 0;
+
+	__HAL_RCC_GPIOA_CLK_ENABLE();
+	__HAL_RCC_GPIOB_CLK_ENABLE();
+	__HAL_RCC_GPIOC_CLK_ENABLE();
+	__HAL_RCC_ADC1_CLK_ENABLE();
+	__HAL_RCC_DMA2_CLK_ENABLE();
+	__HAL_RCC_TIM2_CLK_ENABLE();
+
+	gpio.Mode = GPIO_MODE_ANALOG;
+	gpio.Pull = GPIO_NOPULL;
+	for (i = 0; i < count; i++)
+	{
+		if (channels[i] > 15)
+			return 0;
+		gpio.Pin = 1u << pins[channels[i]];
+		HAL_GPIO_Init(ports[channels[i]], &gpio);
+	}
+
+	//!ADC1 -> DMA2 Stream0 Channel0, по кругу: прерывания на половине и в конце буфера
+	AdcDmaHandle.Instance					= DMA2_Stream0;
+	AdcDmaHandle.Init.Channel				= DMA_CHANNEL_0;
+	AdcDmaHandle.Init.Direction				= DMA_PERIPH_TO_MEMORY;
+	AdcDmaHandle.Init.PeriphInc				= DMA_PINC_DISABLE;
+	AdcDmaHandle.Init.MemInc				= DMA_MINC_ENABLE;
+	AdcDmaHandle.Init.PeriphDataAlignment	= DMA_PDATAALIGN_HALFWORD;
+	AdcDmaHandle.Init.MemDataAlignment		= DMA_MDATAALIGN_HALFWORD;
+	AdcDmaHandle.Init.Mode					= DMA_CIRCULAR;
+	AdcDmaHandle.Init.Priority				= DMA_PRIORITY_LOW;
+	AdcDmaHandle.Init.FIFOMode				= DMA_FIFOMODE_DISABLE;
+	if (HAL_DMA_Init(&AdcDmaHandle) != HAL_OK)
+		return 0;
+	__HAL_LINKDMA(&AdcHandle, DMA_Handle, AdcDmaHandle);
+	HAL_NVIC_SetPriority(DMA2_Stream0_IRQn, 6, 0);
+	HAL_NVIC_EnableIRQ(DMA2_Stream0_IRQn);
+
+	//!Одна последовательность всех каналов по каждому TRGO таймера, без участия процессора
+	AdcHandle.Instance						= ADC1;
+	AdcHandle.Init.ClockPrescaler			= ADC_CLOCK_SYNC_PCLK_DIV4;
+	AdcHandle.Init.Resolution				= ADC_RESOLUTION_12B;
+	AdcHandle.Init.ScanConvMode				= ENABLE;
+	AdcHandle.Init.ContinuousConvMode		= DISABLE;
+	AdcHandle.Init.DiscontinuousConvMode	= DISABLE;
+	AdcHandle.Init.ExternalTrigConvEdge		= ADC_EXTERNALTRIGCONVEDGE_RISING;
+	AdcHandle.Init.ExternalTrigConv			= ADC_EXTERNALTRIGCONV_T2_TRGO;
+	AdcHandle.Init.DataAlign				= ADC_DATAALIGN_RIGHT;
+	AdcHandle.Init.NbrOfConversion			= count;
+	AdcHandle.Init.DMAContinuousRequests	= ENABLE;
+	AdcHandle.Init.EOCSelection				= ADC_EOC_SEQ_CONV;
+	if (HAL_ADC_Init(&AdcHandle) != HAL_OK)
+		return 0;
+	//!Выход делителя с NTC 10 кОм: длинная выборка
+	channel.SamplingTime = ADC_SAMPLETIME_144CYCLES;
+	for (i = 0; i < count; i++)
+	{
+		channel.Channel = channels[i];
+		channel.Rank = i + 1;
+		if (HAL_ADC_ConfigChannel(&AdcHandle, &channel) != HAL_OK)
+			return 0;
+	}
+
+	//!TIM2 на APB1 (тактирование таймера - 2 * PCLK1), счёт 1 МГц, TRGO по переполнению
+	AdcTimHandle.Instance				= TIM2;
+	AdcTimHandle.Init.Prescaler			= 2 * HAL_RCC_GetPCLK1Freq() / 1000000 - 1;
+	AdcTimHandle.Init.Period			= 1000000 / rateHz - 1;
+	AdcTimHandle.Init.CounterMode		= TIM_COUNTERMODE_UP;
+	AdcTimHandle.Init.ClockDivision		= TIM_CLOCKDIVISION_DIV1;
+	if (HAL_TIM_Base_Init(&AdcTimHandle) != HAL_OK)
+		return 0;
+	master.MasterOutputTrigger = TIM_TRGO_UPDATE;
+	master.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+	if (HAL_TIMEx_MasterConfigSynchronization(&AdcTimHandle, &master) != HAL_OK)
+		return 0;
+
+	if (HAL_ADC_Start_DMA(&AdcHandle, (uint32_t *)buffer, length) != HAL_OK)
+		return 0;
+	return HAL_TIM_Base_Start(&AdcTimHandle) == HAL_OK;
+#else
+	//!Different init functions
+	return 0;
+#endif
+}
+
+int i2c_init(void (*i2c_CallBack)(int error))
+{
+	i2c_CallBack_func = i2c_CallBack;
+#ifdef STM32_BUILD
+	GPIO_InitTypeDef gpio = { 0 };
+
+	__HAL_RCC_GPIOH_CLK_ENABLE();
+	__HAL_RCC_I2C2_CLK_ENABLE();
+	__HAL_RCC_DMA1_CLK_ENABLE();
+
+	gpio.Pin = DISCOVERY_EXT_I2Cx_SCL_PIN | DISCOVERY_EXT_I2Cx_SDA_PIN;
+	gpio.Mode = GPIO_MODE_AF_OD;
+	gpio.Pull = GPIO_PULLUP;
+	gpio.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+	gpio.Alternate = DISCOVERY_EXT_I2Cx_SCL_SDA_AF;
+	HAL_GPIO_Init(DISCOVERY_EXT_I2Cx_SCL_SDA_GPIO_PORT, &gpio);
+
+	//!I2C2_RX -> DMA1 Stream3 Channel7. Адресная фаза идёт по прерываниям I2C, данные - по DMA
+	I2cDmaHandle.Instance					= DMA1_Stream3;
+	I2cDmaHandle.Init.Channel				= DMA_CHANNEL_7;
+	I2cDmaHandle.Init.Direction				= DMA_PERIPH_TO_MEMORY;
+	I2cDmaHandle.Init.PeriphInc				= DMA_PINC_DISABLE;
+	I2cDmaHandle.Init.MemInc				= DMA_MINC_ENABLE;
+	I2cDmaHandle.Init.PeriphDataAlignment	= DMA_PDATAALIGN_BYTE;
+	I2cDmaHandle.Init.MemDataAlignment		= DMA_MDATAALIGN_BYTE;
+	I2cDmaHandle.Init.Mode					= DMA_NORMAL;
+	I2cDmaHandle.Init.Priority				= DMA_PRIORITY_LOW;
+	I2cDmaHandle.Init.FIFOMode				= DMA_FIFOMODE_DISABLE;
+	if (HAL_DMA_Init(&I2cDmaHandle) != HAL_OK)
+		return 0;
+	__HAL_LINKDMA(&I2cHandle, hdmarx, I2cDmaHandle);
+
+	I2cHandle.Instance				= DISCOVERY_EXT_I2Cx;
+	I2cHandle.Init.Timing			= I2C_TIMING_400K;
+	I2cHandle.Init.OwnAddress1		= 0;
+	I2cHandle.Init.AddressingMode	= I2C_ADDRESSINGMODE_7BIT;
+	I2cHandle.Init.DualAddressMode	= I2C_DUALADDRESS_DISABLE;
+	I2cHandle.Init.OwnAddress2		= 0;
+	I2cHandle.Init.GeneralCallMode	= I2C_GENERALCALL_DISABLE;
+	I2cHandle.Init.NoStretchMode	= I2C_NOSTRETCH_DISABLE;
+	if (HAL_I2C_Init(&I2cHandle) != HAL_OK)
+		return 0;
+	if (HAL_I2CEx_ConfigAnalogFilter(&I2cHandle, I2C_ANALOGFILTER_ENABLE) != HAL_OK)
+		return 0;
+
+	HAL_NVIC_SetPriority(DISCOVERY_EXT_I2Cx_EV_IRQn, 6, 0);
+	HAL_NVIC_EnableIRQ(DISCOVERY_EXT_I2Cx_EV_IRQn);
+	HAL_NVIC_SetPriority(DISCOVERY_EXT_I2Cx_ER_IRQn, 6, 0);
+	HAL_NVIC_EnableIRQ(DISCOVERY_EXT_I2Cx_ER_IRQn);
+	HAL_NVIC_SetPriority(DMA1_Stream3_IRQn, 6, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Stream3_IRQn);
+	return 1;
+#else
+	//!Different init functions
+	return 0;
+#endif
+}
+
+int i2c_read_dma(uint8_t address, uint8_t reg, uint8_t *data, int length)
+{
+#ifdef STM32_BUILD
+	return HAL_I2C_Mem_Read_DMA(&I2cHandle, (uint16_t)(address << 1), reg, I2C_MEMADD_SIZE_8BIT, data, length) == HAL_OK;
+#else
+	//!Different init functions
+	return 0;
+#endif
+}
+
+int onewire_bus_init(int chains, void (*ow_CallBack)(void))
+{
+	ow_CallBack_func = ow_CallBack;
+#ifdef STM32_BUILD
+	GPIO_InitTypeDef gpio = { 0 };
+	int i = 0;
+
+	if (chains < 1 || chains > (int)(sizeof(owPins) / sizeof(owPins[0])))
+		return 0;
+	owChains = chains;
+	__HAL_RCC_GPIOB_CLK_ENABLE();
+	__HAL_RCC_TIM5_CLK_ENABLE();
+
+	gpio.Mode = GPIO_MODE_OUTPUT_OD;
+	gpio.Pull = GPIO_NOPULL;
+	gpio.Speed = GPIO_SPEED_FREQ_LOW;
+	for (i = 0; i < chains; i++)
+	{
+		gpio.Pin |= owPins[i];
+	}
+	HAL_GPIO_WritePin(GPIOB, gpio.Pin, GPIO_PIN_SET);
+	HAL_GPIO_Init(GPIOB, &gpio);
+
+	//!TIM5 на APB1 (тактирование таймера - 2 * PCLK1), счёт 1 МГц, один импульс. Прерывание выше приоритета ядра ОС:
+	//!критические секции FreeRTOS не растягивают слоты, из прерывания нет вызовов ОС
+	OwTimHandle.Instance			= TIM5;
+	OwTimHandle.Init.Prescaler		= 2 * HAL_RCC_GetPCLK1Freq() / 1000000 - 1;
+	OwTimHandle.Init.Period			= 0xFFFFFFFF;
+	OwTimHandle.Init.CounterMode	= TIM_COUNTERMODE_UP;
+	OwTimHandle.Init.ClockDivision	= TIM_CLOCKDIVISION_DIV1;
+	if (HAL_TIM_Base_Init(&OwTimHandle) != HAL_OK)
+		return 0;
+	//!Запись ARR без программного события обновления: прерывание только по окончании счёта
+	TIM5->CR1 |= TIM_CR1_OPM | TIM_CR1_URS;
+	__HAL_TIM_ENABLE_IT(&OwTimHandle, TIM_IT_UPDATE);
+	HAL_NVIC_SetPriority(TIM5_IRQn, 2, 0);
+	HAL_NVIC_EnableIRQ(TIM5_IRQn);
+	return 1;
+#else
+	//!Different init functions
+	(void)chains;
+	return 0;
+#endif
+}
+
+RAM_I_TCM void onewire_drive(uint32_t low)
+{
+#ifdef STM32_BUILD
+	uint32_t bsrr = 0;
+	int i = 0;
+	for (i = 0; i < owChains; i++)
+	{
+		bsrr |= (low >> i) & 1 ? (uint32_t)owPins[i] << 16 : owPins[i];
+	}
+	GPIOB->BSRR = bsrr;
+#else
+	//!Different init functions
+	(void)low;
+#endif
+}
+
+RAM_I_TCM uint32_t onewire_sample(void)
+{
+#ifdef STM32_BUILD
+	uint32_t idr = GPIOB->IDR, level = 0;
+	int i = 0;
+	for (i = 0; i < owChains; i++)
+	{
+		level |= (idr & owPins[i]) ? 1UL << i : 0;
+	}
+	return level;
+#else
+	//!Different init functions
+	return 0;
+#endif
+}
+
+RAM_I_TCM void onewire_timer(uint32_t us)
+{
+#ifdef STM32_BUILD
+	TIM5->CNT = 0;
+	TIM5->ARR = us ? us - 1 : 0;
+	TIM5->CR1 |= TIM_CR1_CEN;
+#else
+	//!Different init functions
+	(void)us;
+#endif
+}
+
+int crc_init(void)
+{
+#ifdef STM32_BUILD
+	__HAL_RCC_CRC_CLK_ENABLE();
+	CrcHandle.Instance						= CRC;
+	CrcHandle.Init.DefaultPolynomialUse		= DEFAULT_POLYNOMIAL_ENABLE;
+	CrcHandle.Init.DefaultInitValueUse		= DEFAULT_INIT_VALUE_ENABLE;
+	CrcHandle.Init.InputDataInversionMode	= CRC_INPUTDATA_INVERSION_BYTE;
+	CrcHandle.Init.OutputDataInversionMode	= CRC_OUTPUTDATA_INVERSION_ENABLE;
+	CrcHandle.InputDataFormat				= CRC_INPUTDATA_FORMAT_BYTES;
+	return HAL_CRC_Init(&CrcHandle) == HAL_OK;
+#else
+	//!Different init functions
+	return 1;
+#endif
+}
+
+uint32_t crc32_calc(const void *data, uint32_t size)
+{
+#ifdef STM32_BUILD
+	return ~HAL_CRC_Calculate(&CrcHandle, (uint32_t *)data, size);
+#else
+	//!Different init functions
+	const uint8_t *bytes = data;
+	uint32_t crc = 0xFFFFFFFF;
+	uint32_t i = 0;
+	int j = 0;
+	for (i = 0; i < size; i++)
+	{
+		crc ^= bytes[i];
+		for (j = 0; j < 8; j++)
+		{
+			crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+		}
+	}
+	return ~crc;
+#endif
 }
 
 #ifdef STM32_BUILD
@@ -167,18 +808,174 @@ static void MPU_Config(void)
 
   HAL_MPU_ConfigRegion(&MPU_InitStruct);
 
+  /* Configure SRAM2 (.dma_buffer) as Normal, Non-cacheable, Shareable for DMA buffers */
+  MPU_InitStruct.Enable = MPU_REGION_ENABLE;
+  MPU_InitStruct.BaseAddress = SRAM2_BASE;
+  MPU_InitStruct.Size = MPU_REGION_SIZE_16KB;
+  MPU_InitStruct.AccessPermission = MPU_REGION_FULL_ACCESS;
+  MPU_InitStruct.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+  MPU_InitStruct.IsCacheable = MPU_ACCESS_NOT_CACHEABLE;
+  MPU_InitStruct.IsShareable = MPU_ACCESS_SHAREABLE;
+  MPU_InitStruct.Number = MPU_REGION_NUMBER1;
+  MPU_InitStruct.TypeExtField = MPU_TEX_LEVEL1;
+  MPU_InitStruct.SubRegionDisable = 0x00;
+  MPU_InitStruct.DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+
+  HAL_MPU_ConfigRegion(&MPU_InitStruct);
+
+  /* Configure the PSRAM on FMC bank 1 as Normal, Write-through for the history ring */
+  MPU_InitStruct.Enable = MPU_REGION_ENABLE;
+  MPU_InitStruct.BaseAddress = 0x60000000;
+  MPU_InitStruct.Size = MPU_REGION_SIZE_512KB;
+  MPU_InitStruct.AccessPermission = MPU_REGION_FULL_ACCESS;
+  MPU_InitStruct.IsBufferable = MPU_ACCESS_NOT_BUFFERABLE;
+  MPU_InitStruct.IsCacheable = MPU_ACCESS_CACHEABLE;
+  MPU_InitStruct.IsShareable = MPU_ACCESS_NOT_SHAREABLE;
+  MPU_InitStruct.Number = MPU_REGION_NUMBER2;
+  MPU_InitStruct.TypeExtField = MPU_TEX_LEVEL0;
+  MPU_InitStruct.SubRegionDisable = 0x00;
+  MPU_InitStruct.DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE;
+
+  HAL_MPU_ConfigRegion(&MPU_InitStruct);
+
   /* Enable the MPU */
   HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
 }
 
-void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+#if UART_LL
+//! Обработчик порта на LL: ISR читается один раз, байты идут напрямую между RDR/TDR и кольцами.
+//! Ошибки (переполнение, ошибка кадра, например байты на старой скорости при её смене) только сбрасываются
+RAM_I_TCM static void uart_irq(int port)
+{
+	uint32_t start = cycle_counter_get();
+	USART_TypeDef *usart = uartPorts[port].instance;
+	uint32_t isr = usart->ISR;
+	uint32_t bytes = 0;
+	uint8_t data = 0;
+	if (isr & (USART_ISR_ORE | USART_ISR_FE | USART_ISR_NE | USART_ISR_PE))
+	{
+		usart->ICR = USART_ICR_ORECF | USART_ICR_FECF | USART_ICR_NCF | USART_ICR_PECF;
+	}
+	if (isr & USART_ISR_RXNE)
+	{
+		uart_rx_byte(port, (uint8_t)usart->RDR);
+		bytes++;
+	}
+	if ((isr & USART_ISR_TXE) && (usart->CR1 & USART_CR1_TXEIE))
+	{
+		if (ring_get(uartTxRing[port], &data))
+		{
+			usart->TDR = data;
+			bytes++;
+		}
+		else
+		{
+			LL_USART_DisableIT_TXE(usart);
+		}
+	}
+	uartIsrBytes[port] += bytes;
+	uartIsrCycles[port] += cycle_counter_get() - start;
+}
+#else
+//! Обработчик порта через HAL_UART_IRQHandler, байты считают обратные вызовы
+RAM_I_TCM static void uart_irq(int port)
+{
+	uint32_t start = cycle_counter_get();
+	HAL_UART_IRQHandler(&UartHandle[port]);
+	uartIsrCycles[port] += cycle_counter_get() - start;
+}
+
+RAM_I_TCM void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+	int port = huart - UartHandle;
+	uart_rx_byte(port, uartRxByte[port]);
+	uartIsrBytes[port]++;
+	HAL_UART_Receive_IT(huart, &uartRxByte[port], sizeof(uint8_t));
+}
+
+//!Переполнение и ошибки кадра (например, байты на старой скорости при её смене) обрывают приём - запускаю его заново
+RAM_I_TCM void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+	if (huart->RxState == HAL_UART_STATE_READY)
+	{
+		HAL_UART_Receive_IT(huart, &uartRxByte[huart - UartHandle], sizeof(uint8_t));
+	}
+}
+
+RAM_I_TCM void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+	int port = huart - UartHandle;
+	uartIsrBytes[port]++;
+	if (ring_get(uartTxRing[port], &uartTxByte[port]))
+	{
+		HAL_UART_Transmit_IT(huart, &uartTxByte[port], sizeof(uint8_t));
+	}
+}
+#endif
+
+RAM_I_TCM void UART4_IRQHandler(void)
+{
+	uart_irq(0);
+}
+
+RAM_I_TCM void USART6_IRQHandler(void)
+{
+	uart_irq(1);
+}
+
+RAM_I_TCM void USART2_IRQHandler(void)
+{
+	uart_irq(2);
+}
+
+RAM_I_TCM void DMA2_Stream0_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(&AdcDmaHandle);
+}
+
+RAM_I_TCM void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc)
+{
+	adc_CallBack_func(0);
+}
+
+RAM_I_TCM void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
+{
+	adc_CallBack_func(1);
+}
+
+RAM_I_TCM void I2C2_EV_IRQHandler(void)
+{
+	HAL_I2C_EV_IRQHandler(&I2cHandle);
+}
+
+RAM_I_TCM void I2C2_ER_IRQHandler(void)
+{
+	HAL_I2C_ER_IRQHandler(&I2cHandle);
+}
+
+RAM_I_TCM void DMA1_Stream3_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(&I2cDmaHandle);
+}
+
+RAM_I_TCM void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+	i2c_CallBack_func(0);
+}
+
+RAM_I_TCM void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
 {
-	uart_RxCallBack_func();
+	i2c_CallBack_func(1);
 }
 
-void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+//!Без HAL_TIM_IRQHandler: HAL_TIM_PeriodElapsedCallback занят таймером тиков HAL (TIM6)
+RAM_I_TCM void TIM5_IRQHandler(void)
 {
-	uart_TxCallBack_func();
+	if (TIM5->SR & TIM_SR_UIF)
+	{
+		__HAL_TIM_CLEAR_IT(&OwTimHandle, TIM_IT_UPDATE);
+		ow_CallBack_func();
+	}
 }
 
 #else
@@ -0,0 +1,610 @@
+/*
+ * onewire.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "onewire.h"
+#include "mpuinit.h"
+#include <string.h>
+
+#define WORDS		((ONEWIRE_SENSORS + 31) / 32)
+#define SCRATCHPAD	9		//!Байт памяти DS18B20 с CRC
+#define POWER_ON	0x0550	//!85 °C - значение до первого преобразования
+
+//!Команды DS18B20
+#define CMD_SKIP_ROM	0xCC
+#define CMD_MATCH_ROM	0x55
+#define CMD_CONVERT		0x44
+#define CMD_READ		0xBE
+
+//!Этапы цикла опроса
+enum
+{
+	STAGE_IDLE,
+	STAGE_CONVERT,	//!Reset, Skip ROM, Convert T
+	STAGE_WAIT,		//!Ожидание преобразования
+	STAGE_READ		//!Reset, Match ROM, Read Scratchpad одного устройства на всех цепочках
+};
+
+//!События слота по таймеру: начало (линии вниз), отпускание единиц, выборка и отпускание всех
+enum
+{
+	EVENT_START,
+	EVENT_RELEASE,
+	EVENT_SAMPLE,
+	EVENT_WAIT
+};
+
+//!Времена событий слота от его начала, мкс: отпускание единиц, выборка, конец слота
+static const uint16_t resetTiming[3] = { 480, 550, 960 };
+static const uint16_t writeTiming[3] = { 6, 60, 70 };
+static const uint16_t readTiming[3] = { 3, 12, 70 };
+
+//!Состояние цикла, им владеет прерывание таймера, пока busy
+static struct
+{
+	int stage;
+	int event;
+	int device;			//!Номер устройства на цепочке в STAGE_READ
+	int slot;			//!0 - reset, затем биты записи и биты чтения
+	int writeBytes;
+	int readBytes;
+	uint32_t chains;	//!Цепочки этапа
+	uint32_t active;	//!Цепочки этапа, ответившие на reset
+	uint32_t ones;		//!Цепочки, у которых в текущем слоте записи единица
+} ow;
+
+//!Копия ROM-кодов из реестра для прерывания таймера: реестр лежит в PSRAM под dataSemaphore, прерыванию он недоступен.
+//!Меняется только через привязку в реестре (owrom, register, unregister) и имитацией при старте
+static uint64_t roms[ONEWIRE_SENSORS];
+static volatile uint8_t bound[ONEWIRE_SENSORS];
+static uint64_t stepRom[ONEWIRE_CHAINS];
+static uint8_t scratch[ONEWIRE_CHAINS][SCRATCHPAD];
+static uint32_t pending[WORDS];	//!Запрошенные устройства. Ставит процесс опроса, снимает прерывание таймера
+static uint32_t cycle[WORDS];	//!Устройства текущего цикла
+static volatile uint8_t result[ONEWIRE_SENSORS];
+static volatile int8_t values[ONEWIRE_SENSORS];
+static int busy = 0;
+static int ready = 0;
+
+static void onewire_event(void);
+
+#ifdef STM32_BUILD
+#define line_drive(low)		onewire_drive(low)
+#define line_sample()		onewire_sample()
+#define line_timer(us)		onewire_timer(us)
+#else
+//!Имитация цепочек: устройства DS18B20 разбирают слоты по длительности нуля на линии, как настоящие.
+//!События таймера, наступившие по времени хоста, обрабатываются, когда процесс опроса проверяет готовность
+//!или время продвигается. Последнее устройство последней цепочки отсутствует
+enum
+{
+	SIM_IDLE,
+	SIM_ROM,	//!Приём команды ROM
+	SIM_MATCH,	//!Приём 64 бит ROM
+	SIM_FUNC,	//!Приём команды функции
+	SIM_TX		//!Выдача памяти
+};
+
+typedef struct
+{
+	int devices;
+	int state;
+	int bits;
+	uint8_t shift;
+	uint64_t match;
+	int selected;		//!-1 - все (Skip ROM), -2 - никто
+	int txPos;
+	int txLow;			//!Устройство держит ноль в текущем слоте чтения
+	int presence;
+	int low;
+	uint32_t lowSince;
+	uint8_t converted[ONEWIRE_DEVICES];
+} SimChain_t;
+
+static SimChain_t sim[ONEWIRE_CHAINS];
+static uint32_t simTime = 0, simNext = 0;
+static uint32_t simClock = 0;	//!Время хоста (onewire_sim_advance): события таймера позже него ещё не наступили
+static int simArmed = 0;
+
+static uint8_t crc8(const uint8_t *data, int length);
+
+static uint64_t sim_rom(int chain, int device)
+{
+	return 0x28 | ((uint64_t)(chain * ONEWIRE_DEVICES + device + 1) << 8);
+}
+
+static void sim_scratchpad(int chain, int device, uint8_t *data)
+{
+	int raw = sim[chain].converted[device] ? ((22 + chain * ONEWIRE_DEVICES + device) << 4) + 8 : POWER_ON;
+	data[0] = (uint8_t)raw;
+	data[1] = (uint8_t)(raw >> 8);
+	data[2] = 0x4B;
+	data[3] = 0x46;
+	data[4] = 0x7F;
+	data[5] = 0xFF;
+	data[6] = 0x0C;
+	data[7] = 0x10;
+	data[8] = crc8(data, 8);
+}
+
+static void sim_receive(SimChain_t *s, int chain, int bit)
+{
+	int i = 0;
+	if (s->state == SIM_MATCH)
+	{
+		s->match |= (uint64_t)bit << s->bits;
+		if (++s->bits < 64)
+			return;
+		s->selected = -2;
+		for (i = 0; i < s->devices; i++)
+		{
+			if (sim_rom(chain, i) == s->match)
+			{
+				s->selected = i;
+			}
+		}
+		s->state = s->selected >= 0 ? SIM_FUNC : SIM_IDLE;
+		s->bits = 0;
+		return;
+	}
+	if (s->state != SIM_ROM && s->state != SIM_FUNC)
+		return;
+	s->shift = (uint8_t)((s->shift >> 1) | (bit << 7));
+	if (++s->bits < 8)
+		return;
+	s->bits = 0;
+	if (s->state == SIM_ROM)
+	{
+		s->state = s->shift == CMD_SKIP_ROM ? SIM_FUNC : s->shift == CMD_MATCH_ROM ? SIM_MATCH : SIM_IDLE;
+		s->selected = -1;
+		s->match = 0;
+		return;
+	}
+	s->state = SIM_IDLE;
+	if (s->shift == CMD_CONVERT)
+	{
+		for (i = 0; i < s->devices; i++)
+		{
+			if (s->selected == -1 || s->selected == i)
+			{
+				s->converted[i] = 1;
+			}
+		}
+	}
+	else if (s->shift == CMD_READ && s->selected >= 0)
+	{
+		s->state = SIM_TX;
+		s->txPos = 0;
+	}
+}
+
+static void line_drive(uint32_t low)
+{
+	int c = 0;
+	for (c = 0; c < ONEWIRE_CHAINS; c++)
+	{
+		SimChain_t *s = &sim[c];
+		int bit = (low >> c) & 1;
+		if (bit && !s->low)
+		{
+			uint8_t data[SCRATCHPAD];
+			s->low = 1;
+			s->lowSince = simTime;
+			s->presence = 0;
+			s->txLow = 0;
+			if (s->state == SIM_TX)
+			{
+				sim_scratchpad(c, s->selected, data);
+				s->txLow = !((data[s->txPos / 8] >> (s->txPos % 8)) & 1);
+			}
+		}
+		else if (!bit && s->low)
+		{
+			uint32_t duration = simTime - s->lowSince;
+			s->low = 0;
+			if (duration >= 480)
+			{
+				s->state = SIM_ROM;
+				s->bits = 0;
+				s->presence = s->devices > 0;
+			}
+			else if (s->state == SIM_TX)
+			{
+				if (++s->txPos == SCRATCHPAD * 8)
+				{
+					s->state = SIM_IDLE;
+				}
+			}
+			else
+			{
+				sim_receive(s, c, duration < 15);
+			}
+		}
+	}
+}
+
+static uint32_t line_sample(void)
+{
+	uint32_t level = 0;
+	int c = 0;
+	for (c = 0; c < ONEWIRE_CHAINS; c++)
+	{
+		if (!sim[c].low && !sim[c].presence && !sim[c].txLow)
+		{
+			level |= 1UL << c;
+		}
+	}
+	return level;
+}
+
+static void line_timer(uint32_t us)
+{
+	simNext = simTime + us;
+	simArmed = 1;
+}
+
+static void sim_run(void)
+{
+	while (simArmed && (int32_t)(simNext - simClock) <= 0)
+	{
+		simArmed = 0;
+		simTime = simNext;
+		onewire_event();
+	}
+}
+
+void onewire_sim_advance(uint32_t us)
+{
+	simClock += us;
+	sim_run();
+}
+#endif
+
+//! CRC-8 Maxim (x^8 + x^5 + x^4 + 1, младшим битом вперёд). По памяти вместе с CRC даёт 0
+RAM_I_TCM static uint8_t crc8(const uint8_t *data, int length)
+{
+	uint8_t crc = 0;
+	int i = 0, j = 0;
+	for (i = 0; i < length; i++)
+	{
+		crc ^= data[i];
+		for (j = 0; j < 8; j++)
+		{
+			crc = (crc & 1) ? (uint8_t)((crc >> 1) ^ 0x8C) : (uint8_t)(crc >> 1);
+		}
+	}
+	return crc;
+}
+
+//! Результат устройства. Результат виден раньше, чем снят запрос
+RAM_I_TCM static void finish(int dev, int ok)
+{
+	result[dev] = ok ? SENSOR_OK : SENSOR_FAIL;
+	cycle[dev / 32] &= ~(1UL << (dev % 32));
+	__atomic_fetch_and(&pending[dev / 32], ~(1UL << (dev % 32)), __ATOMIC_RELEASE);
+}
+
+//! Цепочки, у которых в цикле есть устройство device (-1 - любое)
+RAM_I_TCM static uint32_t cycle_chains(int device)
+{
+	uint32_t chains = 0;
+	int c = 0, k = 0;
+	for (c = 0; c < ONEWIRE_CHAINS; c++)
+	{
+		for (k = 0; k < ONEWIRE_DEVICES; k++)
+		{
+			int dev = c * ONEWIRE_DEVICES + k;
+			if ((device < 0 || device == k) && (cycle[dev / 32] & (1UL << (dev % 32))))
+			{
+				chains |= 1UL << c;
+			}
+		}
+	}
+	return chains;
+}
+
+//! Этап из reset, writeBytes байт записи и readBytes байт чтения на цепочках chains, первый слот через delay мкс
+RAM_I_TCM static void step_begin(int stage, uint32_t chains, int writeBytes, int readBytes, uint32_t delay)
+{
+	ow.stage = stage;
+	ow.event = EVENT_START;
+	ow.slot = 0;
+	ow.chains = chains;
+	ow.active = chains;
+	ow.writeBytes = writeBytes;
+	ow.readBytes = readBytes;
+	line_timer(delay);
+}
+
+//! Байт записи цепочки chain: номер байта в этапе -> команда или байт ROM (младшим вперёд)
+RAM_I_TCM static uint8_t write_byte(int chain, int index)
+{
+	if (ow.stage == STAGE_CONVERT)
+		return index ? CMD_CONVERT : CMD_SKIP_ROM;
+	if (index == 0)
+		return CMD_MATCH_ROM;
+	if (index <= 8)
+		return (uint8_t)(stepRom[chain] >> ((index - 1) * 8));
+	return CMD_READ;
+}
+
+static void kick(void);
+
+//! Чтение следующего устройства цикла (по номеру на цепочке, все цепочки сразу) или конец цикла
+RAM_I_TCM static void next_device(uint32_t delay)
+{
+	int c = 0;
+	while (++ow.device < ONEWIRE_DEVICES)
+	{
+		uint32_t chains = cycle_chains(ow.device);
+		if (!chains)
+			continue;
+		for (c = 0; c < ONEWIRE_CHAINS; c++)
+		{
+			stepRom[c] = roms[c * ONEWIRE_DEVICES + ow.device];
+		}
+		memset(scratch, 0, sizeof(scratch));
+		step_begin(STAGE_READ, chains, 10, SCRATCHPAD, delay);
+		return;
+	}
+	ow.stage = STAGE_IDLE;
+	__atomic_store_n(&busy, 0, __ATOMIC_RELEASE);
+	//!Запросы, поставленные во время цикла
+	kick();
+}
+
+//! Конец этапа: после Convert T - ожидание, после чтения - проверка памяти устройства на каждой цепочке
+RAM_I_TCM static void step_end(uint32_t delay)
+{
+	int c = 0, k = 0;
+	for (c = 0; c < ONEWIRE_CHAINS; c++)
+	{
+		if (!(ow.chains & (1UL << c)))
+			continue;
+		if (ow.stage == STAGE_CONVERT)
+		{
+			if (ow.active & (1UL << c))
+				continue;
+			//!Цепочка не ответила на reset: все её устройства с ошибкой
+			for (k = 0; k < ONEWIRE_DEVICES; k++)
+			{
+				int dev = c * ONEWIRE_DEVICES + k;
+				if (cycle[dev / 32] & (1UL << (dev % 32)))
+				{
+					finish(dev, 0);
+				}
+			}
+			continue;
+		}
+		const uint8_t *data = scratch[c];
+		int raw = (int16_t)((data[1] << 8) | data[0]);
+		//!Биты 0..4 регистра конфигурации всегда единицы: отсекает замкнутую линию с нулевой CRC
+		int ok = (ow.active & (1UL << c)) && crc8(data, SCRATCHPAD) == 0 && (data[4] & 0x1F) == 0x1F && raw != POWER_ON;
+		int value = (raw + 8) >> 4;
+		int dev = c * ONEWIRE_DEVICES + ow.device;
+		if (ok)
+		{
+			values[dev] = (int8_t)(value > 127 ? 127 : value);
+		}
+		finish(dev, ok);
+	}
+	if (ow.stage == STAGE_CONVERT && ow.active)
+	{
+		ow.stage = STAGE_WAIT;
+		ow.event = EVENT_WAIT;
+		line_timer(ONEWIRE_CONVERT_US);
+		return;
+	}
+	if (ow.stage == STAGE_CONVERT)
+	{
+		ow.device = -1;
+	}
+	next_device(delay);
+}
+
+//! Прерывание таймера: очередное событие слота
+RAM_I_TCM static void onewire_event(void)
+{
+	int writeBits = ow.writeBytes * 8;
+	int c = 0;
+	if (ow.event == EVENT_WAIT)
+	{
+		ow.device = -1;
+		next_device(1);
+		return;
+	}
+	const uint16_t *timing = ow.slot == 0 ? resetTiming : ow.slot <= writeBits ? writeTiming : readTiming;
+	switch (ow.event)
+	{
+		case EVENT_START:
+			ow.ones = ow.active;
+			if (ow.slot > 0 && ow.slot <= writeBits)
+			{
+				int bit = ow.slot - 1;
+				ow.ones = 0;
+				for (c = 0; c < ONEWIRE_CHAINS; c++)
+				{
+					if ((write_byte(c, bit / 8) >> (bit % 8)) & 1)
+					{
+						ow.ones |= 1UL << c;
+					}
+				}
+				ow.ones &= ow.active;
+			}
+			line_drive(ow.active);
+			ow.event = EVENT_RELEASE;
+			line_timer(timing[0]);
+			break;
+		case EVENT_RELEASE:
+			line_drive(ow.active & ~ow.ones);
+			ow.event = EVENT_SAMPLE;
+			line_timer(timing[1] - timing[0]);
+			break;
+		default:
+		{
+			uint32_t level = 0;
+			line_drive(0);
+			level = line_sample();
+			if (ow.slot == 0)
+			{
+				//!Импульс присутствия - ноль на линии
+				ow.active &= ~level;
+			}
+			else if (ow.slot > writeBits)
+			{
+				int bit = ow.slot - 1 - writeBits;
+				for (c = 0; c < ONEWIRE_CHAINS; c++)
+				{
+					if (level & (1UL << c))
+					{
+						scratch[c][bit / 8] |= (uint8_t)(1 << (bit % 8));
+					}
+				}
+			}
+			ow.event = EVENT_START;
+			ow.slot++;
+			if (!ow.active || ow.slot > writeBits + ow.readBytes * 8)
+			{
+				step_end(timing[2] - timing[1]);
+				break;
+			}
+			line_timer(timing[2] - timing[1]);
+			break;
+		}
+	}
+}
+
+//! Начало цикла по запрошенным устройствам. 0 - опрашивать некого
+RAM_I_TCM static int cycle_start(void)
+{
+	int w = 0, dev = 0;
+	for (w = 0; w < WORDS; w++)
+	{
+		cycle[w] = __atomic_load_n(&pending[w], __ATOMIC_ACQUIRE);
+	}
+	for (dev = 0; dev < ONEWIRE_SENSORS; dev++)
+	{
+		if ((cycle[dev / 32] & (1UL << (dev % 32))) && !bound[dev])
+		{
+			finish(dev, 0);
+		}
+	}
+	uint32_t chains = cycle_chains(-1);
+	if (!chains)
+		return 0;
+	step_begin(STAGE_CONVERT, chains, 2, 0, 1);
+	return 1;
+}
+
+//! Запуск цикла, если он не идёт. Циклом владеет тот, кто перевёл busy из 0 в 1
+RAM_I_TCM static void kick(void)
+{
+	int w = 0;
+	for (w = 0; w < WORDS; w++)
+	{
+		if (!__atomic_load_n(&pending[w], __ATOMIC_ACQUIRE))
+			continue;
+		if (__atomic_exchange_n(&busy, 1, __ATOMIC_ACQ_REL))
+			return;
+		if (cycle_start())
+			return;
+		__atomic_store_n(&busy, 0, __ATOMIC_RELEASE);
+		w = -1;
+	}
+}
+
+int onewire_init(void)
+{
+#ifdef STM32_BUILD
+	ready = onewire_bus_init(ONEWIRE_CHAINS, onewire_event);
+#else
+	int c = 0, k = 0;
+	for (c = 0; c < ONEWIRE_CHAINS; c++)
+	{
+		sim[c].devices = c == ONEWIRE_CHAINS - 1 ? ONEWIRE_DEVICES - 1 : ONEWIRE_DEVICES;
+		for (k = 0; k < ONEWIRE_DEVICES; k++)
+		{
+			onewire_bind(ONEWIRE_FIRST + c * ONEWIRE_DEVICES + k, sim_rom(c, k));
+		}
+	}
+	ready = 1;
+#endif
+	return ready;
+}
+
+//! ROM-код устройства датчика sensor, 0 - отвязать. Привязка, изменённая во время чтения устройства, даёт одну ошибку CRC.
+//! Возвращает 0, если sensor не датчик 1-Wire
+int onewire_bind(int sensor, uint64_t rom)
+{
+	int dev = sensor - ONEWIRE_FIRST;
+	if (dev < 0 || dev >= ONEWIRE_SENSORS)
+		return 0;
+	bound[dev] = 0;
+	memory_barrier();
+	roms[dev] = rom;
+	memory_barrier();
+	bound[dev] = rom != 0;
+	return 1;
+}
+
+//! Привязанный ROM-код датчика sensor. Возвращает 0, если датчик не привязан
+int onewire_rom(int sensor, uint64_t *rom)
+{
+	int dev = sensor - ONEWIRE_FIRST;
+	if (dev < 0 || dev >= ONEWIRE_SENSORS || !bound[dev])
+		return 0;
+	*rom = roms[dev];
+	return 1;
+}
+
+static int onewire_begin(const SensorBus_t *bus, const uint32_t *set, int first, int count)
+{
+	int i = 0;
+	if (!ready)
+		return 0;
+	for (i = first; i < first + count; i++)
+	{
+		int dev = i - bus->first;
+		//!Результат прошлого цикла ещё не забран: его и отдаст чтение, новый цикл устройству не нужен
+		if ((set[i / 32] & (1UL << (i % 32))) && result[dev] == SENSOR_SKIP)
+		{
+			__atomic_fetch_or(&pending[dev / 32], 1UL << (dev % 32), __ATOMIC_RELEASE);
+		}
+	}
+	kick();
+	return 1;
+}
+
+static int onewire_ready(const SensorBus_t *bus)
+{
+	(void)bus;
+#ifndef STM32_BUILD
+	sim_run();
+#endif
+	return !__atomic_load_n(&busy, __ATOMIC_ACQUIRE);
+}
+
+//! Устройства, чтение которых ещё не закончено (цикл дольше тика опроса), отдаются как не опрошенные:
+//! это не ошибка датчика, срок его опроса не сдвигается, результат заберёт один из следующих тиков
+static int onewire_batch(const SensorBus_t *bus, int first, int count, int8_t *out, uint8_t *status)
+{
+	int i = 0;
+	for (i = 0; i < count; i++)
+	{
+		int dev = first + i - bus->first;
+		if (__atomic_load_n(&pending[dev / 32], __ATOMIC_ACQUIRE) & (1UL << (dev % 32)))
+		{
+			status[i] = SENSOR_SKIP;
+			continue;
+		}
+		status[i] = result[dev];
+		out[i] = values[dev];
+		result[dev] = SENSOR_SKIP;
+	}
+	return ready;
+}
+
+const SensorDriver_t onewire_driver = { onewire_begin, onewire_ready, onewire_batch };
@@ -0,0 +1,93 @@
+/*
+ * poll.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "poll.h"
+#include "mpuinit.h"
+
+typedef struct
+{
+	uint32_t due;		//!Время следующего чтения, мс
+	uint16_t interval;	//!Текущий интервал, мс
+} PollSensor_t;
+
+static PollSensor_t sensors[POLL_SENSORS];
+static int periodMin = 1000;
+static int periodMax = 1000;
+//!Чтения за текущую и за последнюю полную секунду
+static uint32_t reads = 0;
+static uint32_t load = 0;
+static uint32_t loadStart = 0;
+
+//! min == max - фиксированный период, иначе адаптивный режим. Все датчики опрашиваются на ближайшем тике после now
+int poll_configure(int minMs, int maxMs, uint32_t now)
+{
+	if (minMs < POLL_PERIOD_MIN || maxMs > POLL_PERIOD_MAX || minMs > maxMs)
+		return 0;
+	periodMin = minMs;
+	periodMax = maxMs;
+	int i = 0;
+	for (i = 0; i < POLL_SENSORS; i++)
+	{
+		sensors[i].due = now;
+		sensors[i].interval = (uint16_t)minMs;
+	}
+	return 1;
+}
+
+int poll_tick_ms(void)
+{
+	return periodMin;
+}
+
+int poll_publish_ms(void)
+{
+	return periodMin == periodMax ? periodMin : POLL_PUBLISH_MS;
+}
+
+RAM_I_TCM int poll_is_due(int sensor, uint32_t now)
+{
+	return (int32_t)(now - sensors[sensor].due) >= 0;
+}
+
+//! Датчик прочитан: при изменении значения интервал сбрасывается в min, иначе удваивается до max
+RAM_I_TCM void poll_done(int sensor, uint32_t now, int changed)
+{
+	PollSensor_t *s = &sensors[sensor];
+	if (changed)
+	{
+		s->interval = (uint16_t)periodMin;
+	}
+	else if (s->interval < periodMax)
+	{
+		s->interval = s->interval * 2 > periodMax ? (uint16_t)periodMax : (uint16_t)(s->interval * 2);
+	}
+	s->due = now + s->interval;
+	reads++;
+}
+
+//! Датчик прочитан, следующее чтение не раньше чем через delayMs (датчик в карантине). Интервал не меняется
+RAM_I_TCM void poll_defer(int sensor, uint32_t now, uint32_t delayMs)
+{
+	sensors[sensor].due = now + delayMs;
+	reads++;
+}
+
+//! Учёт нагрузки: количество чтений за последнюю секунду
+void poll_tick(uint32_t now)
+{
+	if (now - loadStart >= 1000)
+	{
+		load = reads * 1000 / (now - loadStart);
+		reads = 0;
+		loadStart = now;
+	}
+}
+
+uint32_t poll_load(void)
+{
+	return load;
+}
@@ -0,0 +1,100 @@
+/*
+ * proto.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "proto.h"
+#include "mpuinit.h"
+#include <string.h>
+
+//!Место кадра в окне повтора
+typedef struct
+{
+	uint16_t seq;
+	uint16_t offset;
+	uint16_t size;
+	uint8_t link;	//!Канал, которому отправлен кадр
+	uint8_t valid;
+} ProtoSlot_t;
+
+//!Кадры лежат в окне подряд, кадр, не помещающийся до конца окна, пишется с начала
+static uint8_t window[PROTO_WINDOW_SIZE] RAM_EXT;
+static ProtoSlot_t slots[PROTO_WINDOW_FRAMES];
+static int head = 0;		//!Смещение следующего кадра в окне
+static int next = 0;		//!Слот следующего кадра (самый старый)
+static int ready = 0;
+
+//! Окно повтора лежит в PSRAM: без неё кадры не строятся (0), ответы идут потоком
+int proto_init(void)
+{
+	memset(slots, 0, sizeof(slots));
+	head = 0;
+	next = 0;
+	ready = ram_ext_init() && crc_init();
+	return ready;
+}
+
+//! Кадр канала link с его номером seq из len байт данных в окне повтора.
+//! Возвращает длину кадра и его адрес в *frame, 0 - данные длиннее PROTO_PAYLOAD_MAX или окна нет (proto_init)
+int proto_frame(uint8_t link, uint16_t seq, uint8_t type, uint32_t epoch, const uint8_t *data, int len, const uint8_t **frame)
+{
+	int size = PROTO_HEADER + len + PROTO_CRC;
+	int i = 0;
+	if (!ready || len < 0 || len > PROTO_PAYLOAD_MAX)
+		return 0;
+	if (head + size > PROTO_WINDOW_SIZE)
+	{
+		head = 0;
+	}
+	//!Кадры, которые затирает новый, из окна уходят
+	for (i = 0; i < PROTO_WINDOW_FRAMES; i++)
+	{
+		if (slots[i].valid && slots[i].offset < head + size && slots[i].offset + slots[i].size > head)
+		{
+			slots[i].valid = 0;
+		}
+	}
+	uint8_t *f = &window[head];
+	f[0] = PROTO_SYNC;
+	f[1] = type;
+	f[2] = (uint8_t)seq;
+	f[3] = (uint8_t)(seq >> 8);
+	f[4] = (uint8_t)epoch;
+	f[5] = (uint8_t)(epoch >> 8);
+	f[6] = (uint8_t)(epoch >> 16);
+	f[7] = (uint8_t)(epoch >> 24);
+	f[8] = (uint8_t)len;
+	f[9] = (uint8_t)(len >> 8);
+	memcpy(&f[PROTO_HEADER], data, len);
+	uint32_t crc = crc32_calc(f, PROTO_HEADER + len);
+	for (i = 0; i < PROTO_CRC; i++)
+	{
+		f[PROTO_HEADER + len + i] = (uint8_t)(crc >> (i * 8));
+	}
+	slots[next].seq = seq;
+	slots[next].offset = (uint16_t)head;
+	slots[next].size = (uint16_t)size;
+	slots[next].link = link;
+	slots[next].valid = 1;
+	next = (next + 1) % PROTO_WINDOW_FRAMES;
+	head += size;
+	*frame = f;
+	return size;
+}
+
+//! Кадр канала link с номером number из окна повтора. Возвращает длину кадра, 0 - кадр уже вытеснен
+int proto_resend(uint8_t link, uint16_t number, const uint8_t **frame)
+{
+	int i = 0;
+	for (i = 0; i < PROTO_WINDOW_FRAMES; i++)
+	{
+		if (slots[i].valid && slots[i].link == link && slots[i].seq == number)
+		{
+			*frame = &window[slots[i].offset];
+			return slots[i].size;
+		}
+	}
+	return 0;
+}
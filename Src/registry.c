@@ -0,0 +1,180 @@
+/*
+ * registry.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "registry.h"
+#include "mpuinit.h"
+#include <string.h>
+
+#define ENTRY_EMPTY		0xFFFF
+#define ENTRY_DELETED	0xFFFE	//!Удалённая запись: поиск идёт дальше, вставка может занять
+
+static uint64_t ids[REGISTRY_SLOTS] RAM_EXT;		//!ID устройства в слоте
+static uint16_t table[REGISTRY_TABLE] RAM_EXT;		//!Номер слота или ENTRY_EMPTY/ENTRY_DELETED
+static uint32_t used[(REGISTRY_SLOTS + 31) / 32];	//!Занятые слоты
+static int count = 0;
+static int deleted = 0;
+static int ready = 0;
+
+//! Перемешивание битов ID (финализатор MurmurHash3): у ROM-кодов одного семейства различаются немногие биты
+static uint32_t hash(uint64_t id)
+{
+	id ^= id >> 33;
+	id *= 0xFF51AFD7ED558CCDULL;
+	id ^= id >> 33;
+	id *= 0xC4CEB9FE1A85EC53ULL;
+	id ^= id >> 33;
+	return (uint32_t)id % REGISTRY_TABLE;
+}
+
+static inline int slot_used(int slot)
+{
+	return (used[slot >> 5] >> (slot & 31)) & 1;
+}
+
+//! Позиция ID в таблице или позиция для вставки (первая удалённая либо пустая), *found - ID найден
+static int lookup(uint64_t id, int *found)
+{
+	uint32_t pos = hash(id);
+	int insert = -1;
+	int i = 0;
+	for (i = 0; i < REGISTRY_TABLE; i++)
+	{
+		uint16_t entry = table[pos];
+		if (entry == ENTRY_EMPTY)
+			break;
+		if (entry == ENTRY_DELETED)
+		{
+			if (insert < 0)
+				insert = pos;
+		}
+		else if (ids[entry] == id)
+		{
+			*found = 1;
+			return pos;
+		}
+		if (++pos == REGISTRY_TABLE)
+			pos = 0;
+	}
+	*found = 0;
+	return insert >= 0 ? insert : (int)pos;
+}
+
+//! Пересборка таблицы из занятых слотов, когда удалённые записи удлиняют поиск
+static void rebuild(void)
+{
+	int slot = 0;
+	memset(table, 0xFF, sizeof(table));
+	deleted = 0;
+	for (slot = 0; slot < REGISTRY_SLOTS; slot++)
+	{
+		if (slot_used(slot))
+		{
+			int found = 0;
+			table[lookup(ids[slot], &found)] = (uint16_t)slot;
+		}
+	}
+}
+
+int registry_init(void)
+{
+	ready = ram_ext_init();
+	if (!ready)
+		return 0;
+	memset(used, 0, sizeof(used));
+	count = 0;
+	rebuild();
+	return 1;
+}
+
+//! Запись ID в свободный слот slot, pos - позиция для вставки из lookup
+static int insert(int pos, uint64_t id, int slot)
+{
+	if (table[pos] == ENTRY_DELETED)
+	{
+		deleted--;
+	}
+	ids[slot] = id;
+	table[pos] = (uint16_t)slot;
+	used[slot >> 5] |= 1u << (slot & 31);
+	count++;
+	return slot;
+}
+
+//! Добавление устройства. Возвращает его слот (уже выданный, если ID зарегистрирован) или REGISTRY_NONE
+int registry_add(uint64_t id)
+{
+	int found = 0;
+	if (!ready || count >= REGISTRY_SLOTS)
+		return REGISTRY_NONE;
+	int pos = lookup(id, &found);
+	if (found)
+		return table[pos];
+	int slot = 0;
+	while (slot_used(slot))
+	{
+		slot++;
+	}
+	return insert(pos, id, slot);
+}
+
+//! Добавление устройства в заданный слот (датчик с известным номером, например 1-Wire).
+//! Возвращает slot или REGISTRY_NONE, если слот занят другим ID или ID уже в другом слоте
+int registry_add_at(uint64_t id, int slot)
+{
+	int found = 0;
+	if (!ready || slot < 0 || slot >= REGISTRY_SLOTS)
+		return REGISTRY_NONE;
+	int pos = lookup(id, &found);
+	if (found)
+		return table[pos] == slot ? slot : REGISTRY_NONE;
+	if (slot_used(slot))
+		return REGISTRY_NONE;
+	return insert(pos, id, slot);
+}
+
+//! Удаление устройства. Возвращает освободившийся слот или REGISTRY_NONE
+int registry_remove(uint64_t id)
+{
+	int found = 0;
+	if (!ready)
+		return REGISTRY_NONE;
+	int pos = lookup(id, &found);
+	if (!found)
+		return REGISTRY_NONE;
+	int slot = table[pos];
+	table[pos] = ENTRY_DELETED;
+	used[slot >> 5] &= ~(1u << (slot & 31));
+	count--;
+	if (++deleted > REGISTRY_TABLE / 4)
+	{
+		rebuild();
+	}
+	return slot;
+}
+
+int registry_find(uint64_t id)
+{
+	int found = 0;
+	if (!ready)
+		return REGISTRY_NONE;
+	int pos = lookup(id, &found);
+	return found ? table[pos] : REGISTRY_NONE;
+}
+
+//! ID устройства в слоте. Возвращает 0, если слот свободен
+int registry_id(int slot, uint64_t *id)
+{
+	if (!ready || slot < 0 || slot >= REGISTRY_SLOTS || !slot_used(slot))
+		return 0;
+	*id = ids[slot];
+	return 1;
+}
+
+int registry_count(void)
+{
+	return count;
+}
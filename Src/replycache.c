@@ -0,0 +1,77 @@
+/*
+ * replycache.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ */
+
+#include "replycache.h"
+#include <string.h>
+
+typedef struct
+{
+	uint16_t first;
+	uint16_t count;
+	uint16_t offset;
+	uint16_t len;
+	uint8_t format;
+} CacheEntry_t;
+
+static uint8_t data[REPLYCACHE_SIZE];
+static CacheEntry_t entries[REPLYCACHE_ENTRIES];
+static int entryCount = 0;
+static int used = 0;
+static uint32_t cacheVersion = 0;
+static uint32_t hits = 0, misses = 0;
+
+//! Сброс кэша при смене версии снимка
+static void check_version(uint32_t version)
+{
+	if (version != cacheVersion)
+	{
+		cacheVersion = version;
+		entryCount = 0;
+		used = 0;
+	}
+}
+
+//! Упакованная порция (first, count) в формате format для версии снимка version. NULL - порции нет
+const uint8_t *replycache_find(uint32_t version, uint8_t format, uint16_t first, uint16_t count, int *len)
+{
+	int i = 0;
+	check_version(version);
+	for (i = 0; i < entryCount; i++)
+	{
+		const CacheEntry_t *entry = &entries[i];
+		if (entry->first == first && entry->count == count && entry->format == format)
+		{
+			hits++;
+			*len = entry->len;
+			return &data[entry->offset];
+		}
+	}
+	misses++;
+	return NULL;
+}
+
+void replycache_store(uint32_t version, uint8_t format, uint16_t first, uint16_t count, const uint8_t *src, int len)
+{
+	check_version(version);
+	if (entryCount == REPLYCACHE_ENTRIES || used + len > REPLYCACHE_SIZE)
+		return;
+	CacheEntry_t *entry = &entries[entryCount++];
+	entry->first = first;
+	entry->count = count;
+	entry->format = format;
+	entry->offset = (uint16_t)used;
+	entry->len = (uint16_t)len;
+	memcpy(&data[used], src, len);
+	used += len;
+}
+
+void replycache_stats(uint32_t *out)
+{
+	out[REPLYCACHE_HITS] = hits;
+	out[REPLYCACHE_MISSES] = misses;
+	out[REPLYCACHE_USED] = used;
+}
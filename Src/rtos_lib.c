@@ -6,9 +6,12 @@
  */
 
 #include "rtos_lib.h"
+#include "mpuinit.h"
 
 #ifdef FREERTOS_BUILD
 #include "cmsis_os.h"
+//!Куча FreeRTOS в DTCM: из неё выделяются стеки процессов и память очередей
+uint8_t ucHeap[configTOTAL_HEAP_SIZE] RAM_D_TCM;
 osThreadId 		threads_id[THREDS_MAX];
 osTimerDef_t	timers_def[TIMERS_MAX];
 osTimerId		timers_id[TIMERS_MAX];
@@ -41,14 +44,20 @@ void rtos_start(void)
 }
 
 int rtos_thread_init(void(*thread_func)(const void*), int priority, int stackSize)
+{
+	return rtos_thread_init_arg(thread_func, NULL, priority, stackSize);
+}
+
+//! Процесс с аргументом (например, номер обработчика среди нескольких одинаковых)
+int rtos_thread_init_arg(void(*thread_func)(const void*), const void *arg, int priority, int stackSize)
 {
 	if (threads_count < THREDS_MAX)
 	{
 #ifdef FREERTOS_BUILD
 		osThreadDef(threads_count, thread_func, priority, 0, stackSize);
-		threads_id[threads_count] = osThreadCreate(osThread(threads_count), NULL);
+		threads_id[threads_count] = osThreadCreate(osThread(threads_count), (void *)arg);
 #else
-		k_thread_create(&threads_id[threads_count], k_thread_stack_alloc(stackSize), stackSize, thread_func, NULL, NULL, NULL, priority, 0, K_NO_WAIT);
+		k_thread_create(&threads_id[threads_count], k_thread_stack_alloc(stackSize), stackSize, thread_func, (void *)arg, NULL, NULL, priority, 0, K_NO_WAIT);
 #endif
 	return threads_count++;
 	}
@@ -58,6 +67,25 @@ int rtos_thread_init(void(*thread_func)(const void*), int priority, int stackSiz
 	}
 }
 
+//! Приостановка текущего процесса на time мс
+void rtos_delay(long long time)
+{
+#ifdef FREERTOS_BUILD
+	osDelay(time);
+#else
+	k_msleep(time);
+#endif
+}
+
+//! Время от старта планировщика, мс (переполняется через 49 суток, сравнивать разностью)
+uint32_t rtos_time_ms(void)
+{
+#ifdef FREERTOS_BUILD
+	return osKernelSysTick() * portTICK_PERIOD_MS;
+#else
+	return k_uptime_get_32();
+#endif
+}
 
 int rtos_queue_init(int queueLength, int itemSize)
 {
@@ -93,6 +121,25 @@ int rtos_queue_send(int queue, const void* data, long long timeToWait)
 		return 0;
 	}
 }
+//!Срочное сообщение: встаёт в начало очереди
+int rtos_queue_send_front(int queue, const void* data, long long timeToWait)
+{
+	if (queue <= queues_count)
+	{
+#ifdef FREERTOS_BUILD
+		if (xQueueSendToFront(queues_id[queue], data, timeToWait < 0 ? portMAX_DELAY : portTICK_PERIOD_MS * timeToWait) == pdTRUE)
+			return 1;
+#else
+		if (!k_msgq_put_front(&queues_id[queue], data))
+			return 1;
+#endif
+		return 0;
+	}
+	else
+	{
+		return 0;
+	}
+}
 int rtos_queue_receive(int queue, void *data, long long timeToWait)
 {
 	if (queue <= queues_count)
@@ -111,6 +158,65 @@ int rtos_queue_receive(int queue, void *data, long long timeToWait)
 		return 0;
 	}
 }
+//! Отправка из обработчика прерывания, без ожидания. Процесс, разбуженный сообщением, запускается сразу по выходе из прерывания
+int rtos_queue_send_isr(int queue, const void* data)
+{
+	if (queue <= queues_count)
+	{
+#ifdef FREERTOS_BUILD
+		BaseType_t woken = pdFALSE;
+		if (xQueueSendFromISR(queues_id[queue], data, &woken) != pdTRUE)
+			return 0;
+		portYIELD_FROM_ISR(woken);
+		return 1;
+#else
+		return !k_msgq_put(&queues_id[queue], data, K_NO_WAIT);
+#endif
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+//! Приём в обработчике прерывания, без ожидания
+int rtos_queue_receive_isr(int queue, void *data)
+{
+	if (queue <= queues_count)
+	{
+#ifdef FREERTOS_BUILD
+		BaseType_t woken = pdFALSE;
+		if (xQueueReceiveFromISR(queues_id[queue], data, &woken) != pdTRUE)
+			return 0;
+		portYIELD_FROM_ISR(woken);
+		return 1;
+#else
+		return !k_msgq_get(&queues_id[queue], data, K_NO_WAIT);
+#endif
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+//! Количество элементов в очереди
+int rtos_queue_count(int queue)
+{
+	if (queue <= queues_count)
+	{
+#ifdef FREERTOS_BUILD
+		return (int)uxQueueMessagesWaiting(queues_id[queue]);
+#else
+		return (int)k_msgq_num_used_get(&queues_id[queue]);
+#endif
+	}
+	else
+	{
+		return 0;
+	}
+}
+
 int rtos_timer_init(int periodic, void(*timerCallBack_func)(const void*))
 {
 	if (timers_count < TIMERS_MAX)
@@ -6,6 +6,15 @@
  */
 
 #include "sensors.h"
+#include "analog.h"
+#include "i2ctemp.h"
+#include "onewire.h"
+
+#define MOCK_FIRST	(ONEWIRE_FIRST + ONEWIRE_SENSORS)
+
+#if MOCK_FIRST > SENSORS_MAX
+#error "Sensor buses do not fit into SENSORS_MAX"
+#endif
 
 static int8_t temp[256] =
 {
@@ -27,7 +36,111 @@ static int8_t temp[256] =
 		20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, -35
 };
 
-int8_t get_temperature(int index)
+//!Набор датчиков имитации, ожидающих чтения
+static uint32_t mockPending[SENSORS_SET_WORDS];
+
+//! Имитация: датчики с номерами больше 255 повторяют первые 256
+static int mock_begin(const SensorBus_t *bus, const uint32_t *set, int first, int count)
+{
+	int i = 0;
+	(void)bus;
+	for (i = first; i < first + count; i++)
+	{
+		if (set[i / 32] & (1UL << (i % 32)))
+		{
+			mockPending[i / 32] |= 1UL << (i % 32);
+		}
+	}
+	return 1;
+}
+
+static int mock_ready(const SensorBus_t *bus)
+{
+	(void)bus;
+	return 1;
+}
+
+static int mock_batch(const SensorBus_t *bus, int first, int count, int8_t *out, uint8_t *status)
+{
+	int i = 0;
+	(void)bus;
+	for (i = 0; i < count; i++)
+	{
+		int n = first + i;
+		uint32_t bit = 1UL << (n % 32);
+		status[i] = (mockPending[n / 32] & bit) ? SENSOR_OK : SENSOR_SKIP;
+		mockPending[n / 32] &= ~bit;
+		out[i] = temp[n % sizeof(temp)];
+	}
+	return 1;
+}
+
+static const SensorDriver_t mock_driver = { mock_begin, mock_ready, mock_batch };
+
+//!Таблица шин, по возрастанию номеров датчиков. Датчики вне шин читаются с ошибкой
+static const SensorBus_t buses[] =
+{
+	{ &analog_driver, ANALOG_FIRST, ANALOG_CHANNELS, 0 },
+	{ &i2ctemp_driver, I2CTEMP_FIRST, I2CTEMP_SENSORS, 0 },
+	{ &onewire_driver, ONEWIRE_FIRST, ONEWIRE_SENSORS, 0 },
+	{ &mock_driver, MOCK_FIRST, SENSORS_MAX - MOCK_FIRST, 0 },
+};
+#define BUSES_COUNT	((int)(sizeof(buses) / sizeof(buses[0])))
+
+//! Пересечение диапазона first..first + count - 1 с шиной. Возвращает длину пересечения, *from - его начало
+static int bus_clip(const SensorBus_t *bus, int first, int count, int *from)
+{
+	int begin = first > bus->first ? first : bus->first;
+	int end = first + count < bus->first + bus->count ? first + count : bus->first + bus->count;
+	*from = begin;
+	return end - begin;
+}
+
+//! Запуск преобразования датчиков набора set в диапазоне first..first + count - 1 на всех шинах.
+//! Возвращает 0, если хотя бы одна шина не приняла запуск
+int sensors_begin(const uint32_t *set, int first, int count)
+{
+	int result = 1, b = 0, from = 0;
+	for (b = 0; b < BUSES_COUNT; b++)
+	{
+		int n = bus_clip(&buses[b], first, count, &from);
+		if (n > 0 && !buses[b].driver->begin_conversion(&buses[b], set, from, n))
+		{
+			result = 0;
+		}
+	}
+	return result;
+}
+
+//! 1 - все шины диапазона закончили преобразование
+int sensors_ready(int first, int count)
+{
+	int b = 0, from = 0;
+	for (b = 0; b < BUSES_COUNT; b++)
+	{
+		if (bus_clip(&buses[b], first, count, &from) > 0 && !buses[b].driver->is_ready(&buses[b]))
+			return 0;
+	}
+	return 1;
+}
+
+//! Чтение диапазона порцией. Датчики, не принадлежащие ни одной шине, и шины с ошибкой чтения - SENSOR_FAIL
+void sensors_read(int first, int count, int8_t *out, uint8_t *status)
 {
-	return temp[index];
+	int b = 0, i = 0, from = 0;
+	for (i = 0; i < count; i++)
+	{
+		status[i] = SENSOR_FAIL;
+	}
+	for (b = 0; b < BUSES_COUNT; b++)
+	{
+		int n = bus_clip(&buses[b], first, count, &from);
+		if (n > 0 && !buses[b].driver->read_batch(&buses[b], from, n, &out[from - first], &status[from - first]))
+		{
+			for (i = from - first; i < from - first + n; i++)
+			{
+				status[i] = SENSOR_FAIL;
+			}
+		}
+	}
 }
@@ -0,0 +1,108 @@
+/*
+ * agg_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Скользящие агрегаты против прямого пересчёта по окну, в том числе на наибольшем окне AGG_WINDOW_MAX:
+ *      убывающая последовательность копит в деке максимумов все позиции окна, возрастающая - в деке минимумов.
+ */
+
+#include "test.h"
+#include "agg.h"
+#include <string.h>
+
+#define SAMPLES		300		//!Больше 256: позиции в деках проходят через переполнение uint8_t
+#define PATTERNS	4
+
+//!Значение датчика i на опросе n: убывающая, возрастающая, псевдослучайная, постоянная
+static int8_t pattern(int i, uint32_t n)
+{
+	switch (i % PATTERNS)
+	{
+	case 0:
+		return (int8_t)(100 - (int)(n % 200));
+	case 1:
+		return (int8_t)((int)(n % 200) - 100);
+	case 2:
+		return (int8_t)((n * 1103515245u + 12345u) >> 16);
+	default:
+		return 25;
+	}
+}
+
+static uint32_t isqrt_ref(uint64_t x)
+{
+	uint64_t r = 0;
+	while ((r + 1) * (r + 1) <= x)
+		r++;
+	return (uint32_t)r;
+}
+
+//! Агрегаты датчика i по последним опросам до samples прямым пересчётом
+static void reference(int i, uint32_t samples, int window, AggResult_t *out)
+{
+	uint32_t n = samples < (uint32_t)window ? samples : (uint32_t)window;
+	int32_t sum = 0;
+	int64_t sumsq = 0;
+	int min = 127, max = -128;
+	uint32_t k = 0;
+	for (k = samples - n; k < samples; k++)
+	{
+		int x = pattern(i, k);
+		sum += x;
+		sumsq += x * x;
+		min = x < min ? x : min;
+		max = x > max ? x : max;
+	}
+	out->min = (int8_t)min;
+	out->max = (int8_t)max;
+	out->mean = (int16_t)((sum * (1 << AGG_FRAC_BITS)) / (int32_t)n);
+	out->stddev = (uint16_t)isqrt_ref((((uint64_t)(n * sumsq - (int64_t)sum * sum)) << (2 * AGG_FRAC_BITS)) / ((uint64_t)n * n));
+}
+
+//! Опросы подряд с окном window, после каждого агрегаты сверяются с прямым пересчётом
+static void run(int window, uint32_t *samples)
+{
+	int8_t values[AGG_SENSORS];
+	AggResult_t got[PATTERNS], ref;
+	uint32_t end = *samples + SAMPLES;
+	int i = 0;
+	CHECK(agg_set_window(window));
+	CHECK_EQ(agg_window(), window);
+	for (; *samples < end; (*samples)++)
+	{
+		for (i = 0; i < AGG_SENSORS; i++)
+		{
+			values[i] = pattern(i, *samples);
+		}
+		agg_update(values);
+		agg_get(0, PATTERNS, got);
+		for (i = 0; i < PATTERNS; i++)
+		{
+			reference(i, *samples + 1, window, &ref);
+			if (memcmp(&got[i], &ref, sizeof(ref)))
+			{
+				printf("window %d sample %u sensor %d: %d %d %d %u, expected %d %d %d %u\n", window, (unsigned)*samples, i,
+						got[i].min, got[i].max, got[i].mean, got[i].stddev, ref.min, ref.max, ref.mean, ref.stddev);
+				testFailed++;
+				return;
+			}
+		}
+	}
+}
+
+int main(void)
+{
+	static const int windows[] = { AGG_WINDOW_MAX, 1, 7, 16, AGG_WINDOW_MAX - 1, AGG_WINDOW_MAX };
+	uint32_t samples = 0;
+	int w = 0;
+	CHECK(!agg_set_window(0));
+	CHECK(!agg_set_window(AGG_WINDOW_MAX + 1));
+	//!Смена окна на ходу пересобирает состояние из сохранённых значений
+	for (w = 0; w < (int)(sizeof(windows) / sizeof(windows[0])); w++)
+	{
+		run(windows[w], &samples);
+	}
+	return TEST_RESULT("agg_test");
+}
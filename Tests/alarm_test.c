@@ -0,0 +1,64 @@
+/*
+ * alarm_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Тревоги с гистерезисом: переходы состояния и отмена перехода, кадр которого не попал в очередь запросов
+ *      (переход находится заново на следующем опросе, пока порог пройден).
+ */
+
+#include "test.h"
+#include "alarm.h"
+#include <string.h>
+
+static int8_t values[ALARM_SENSORS];
+static AlarmEvent_t events[ALARM_EVENTS_MAX];
+
+int main(void)
+{
+	memset(values, 25, sizeof(values));
+	CHECK(!alarm_set(0, 30, 20, 2));
+	CHECK(alarm_set(0, 10, 30, 2));
+	CHECK_EQ(alarm_check(values, events), 0);
+
+	//!Выше порога - HIGH, с гистерезисом возврат только на 28
+	values[0] = 31;
+	CHECK_EQ(alarm_check(values, events), 1);
+	CHECK_EQ(events[0].sensor, 0);
+	CHECK_EQ(events[0].state, ALARM_HIGH);
+	CHECK_EQ(events[0].prev, ALARM_NORMAL);
+	CHECK_EQ(events[0].value, 31);
+	CHECK_EQ(alarm_check(values, events), 0);
+	values[0] = 29;
+	CHECK_EQ(alarm_check(values, events), 0);
+	values[0] = 28;
+	CHECK_EQ(alarm_check(values, events), 1);
+	CHECK_EQ(events[0].state, ALARM_NORMAL);
+
+	//!Кадр не отправлен: переход отменяется и повторяется на следующем опросе
+	values[0] = 5;
+	CHECK_EQ(alarm_check(values, events), 1);
+	CHECK_EQ(events[0].state, ALARM_LOW);
+	alarm_revert(&events[0]);
+	CHECK_EQ(alarm_check(values, events), 1);
+	CHECK_EQ(events[0].state, ALARM_LOW);
+	CHECK_EQ(events[0].prev, ALARM_NORMAL);
+
+	//!Значение вернулось до повтора: сервер не узнал о переходе, и отправлять нечего
+	values[0] = 35;
+	CHECK_EQ(alarm_check(values, events), 1);
+	CHECK_EQ(events[0].state, ALARM_HIGH);
+	alarm_revert(&events[0]);
+	values[0] = 8;
+	CHECK_EQ(alarm_check(values, events), 0);
+
+	//!Пороги заданы заново до отмены: отмена не трогает новое состояние
+	values[0] = 35;
+	CHECK_EQ(alarm_check(values, events), 1);
+	CHECK(alarm_set(0, 10, 30, 2));
+	alarm_revert(&events[0]);
+	CHECK_EQ(alarm_check(values, events), 1);
+	CHECK_EQ(events[0].prev, ALARM_NORMAL);
+	return TEST_RESULT("alarm_test");
+}
@@ -0,0 +1,188 @@
+/*
+ * calib_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Сохранение калибровки двумя копиями на имитации сектора QSPI FLASH (запись только сбрасывает биты,
+ *      стирание - блоками QSPI_ERASE_SIZE): загружается последняя сохранённая таблица, а запись, оборванная
+ *      сбросом, не портит предыдущую.
+ */
+
+#include "test.h"
+#include "calib.h"
+#include "mpuinit.h"
+#include <string.h>
+
+#define SENSORS		64	//!Датчиков в проверке прохода калибровки
+
+static uint8_t flash[FLASHLOG_SECTOR_SIZE];	//!Последний сектор FLASH
+static int writesLeft = -1;	//!Записей до "сброса" (дальше запись и стирание не выполняются), -1 - без ограничения
+
+int ram_ext_init(void)
+{
+	return 1;
+}
+
+uint32_t cycle_counter_get(void)
+{
+	return 0;
+}
+
+static int in_sector(uint32_t addr, uint32_t size)
+{
+	return addr >= CALIB_FLASH_ADDR && addr + size <= CALIB_FLASH_ADDR + FLASHLOG_SECTOR_SIZE;
+}
+
+int qspi_read(uint32_t addr, void *data, uint32_t size)
+{
+	if (!in_sector(addr, size))
+		return 0;
+	memcpy(data, &flash[addr - CALIB_FLASH_ADDR], size);
+	return 1;
+}
+
+int qspi_write(uint32_t addr, const void *data, uint32_t size)
+{
+	uint32_t i = 0;
+	if (!in_sector(addr, size) || !writesLeft)
+		return 0;
+	if (writesLeft > 0)
+		writesLeft--;
+	for (i = 0; i < size; i++)
+	{
+		flash[addr - CALIB_FLASH_ADDR + i] &= ((const uint8_t *)data)[i];
+	}
+	return 1;
+}
+
+int qspi_erase(uint32_t addr)
+{
+	if (!in_sector(addr, 1) || !writesLeft)
+		return 0;
+	memset(&flash[(addr - CALIB_FLASH_ADDR) & ~(uint32_t)(QSPI_ERASE_SIZE - 1)], 0xFF, QSPI_ERASE_SIZE);
+	return 1;
+}
+
+//! Калибровка одного датчика прямым расчётом: кривая (за крайними точками - крайнее значение, деление с округлением),
+//! затем x * (1 + gain / 256) + offset / 4 с округлением к ближайшему и насыщением
+static int reference(int x, int gain, int offset, int count, const int8_t *cx, const int8_t *cy)
+{
+	if (count >= 2)
+	{
+		int i = 1;
+		if (x <= cx[0])
+			x = cy[0];
+		else
+		{
+			while (i < count - 1 && x > cx[i])
+				i++;
+			if (x >= cx[i])
+				x = cy[i];
+			else
+			{
+				int dx = cx[i] - cx[i - 1], dy = (cy[i] - cy[i - 1]) * (x - cx[i - 1]);
+				x = cy[i - 1] + (dy >= 0 ? dy + dx / 2 : dy - dx / 2) / dx;
+			}
+		}
+	}
+	int y = (x * (256 + gain) + offset * 64 + 128) >> 8;
+	return y > 127 ? 127 : y < -128 ? -128 : y;
+}
+
+//! Проход по снимку против прямого расчёта: четвёрки без калибровки, с коэффициентом и смещением, с кривыми
+static void check_apply(void)
+{
+	static const int8_t cx[3] = { -40, 0, 100 }, cy[3] = { -38, 2, 97 };
+	static int8_t raw[SENSORS], out[SENSORS];
+	int i = 0, x = 0;
+	for (i = 0; i < 3; i++)
+	{
+		CHECK(calib_point(1, i, cx[i], cy[i]));
+	}
+	for (i = 0; i < SENSORS; i++)
+	{
+		//!Четвёрки 0 и 3 по модулю 4 - без калибровки, в остальных кривая у каждого третьего датчика
+		int calibrated = (i / 4) % 4 != 0 && (i / 4) % 4 != 3;
+		CHECK(calib_set(i, calibrated ? (i * 37) % 256 - 128 : 0, calibrated ? (i * 53) % 256 - 128 : 0,
+				calibrated && i % 3 == 0));
+	}
+	for (x = -128; x < 128; x += 5)
+	{
+		for (i = 0; i < SENSORS; i++)
+		{
+			raw[i] = (int8_t)(x + i % 7);
+		}
+		calib_apply(raw, out, SENSORS);
+		for (i = 0; i < SENSORS; i++)
+		{
+			int calibrated = (i / 4) % 4 != 0 && (i / 4) % 4 != 3;
+			int ref = calibrated ? reference(raw[i], (i * 37) % 256 - 128, (i * 53) % 256 - 128, i % 3 == 0 ? 3 : 0, cx, cy) : raw[i];
+			if (out[i] != ref)
+			{
+				printf("sensor %d raw %d: %d, expected %d\n", i, raw[i], out[i], ref);
+				testFailed++;
+				return;
+			}
+		}
+	}
+	for (i = 0; i < SENSORS; i++)
+	{
+		calib_set(i, 0, 0, 0);
+	}
+}
+
+//! Калиброванное значение 100 °C датчика 0
+static int calibrated(void)
+{
+	int8_t raw[4] = { 100, 0, 0, 0 }, out[4];
+	calib_apply(raw, out, 4);
+	return out[0];
+}
+
+int main(void)
+{
+	memset(flash, 0xFF, sizeof(flash));
+	CHECK(!calib_load());
+	CHECK_EQ(calibrated(), 100);
+	check_apply();
+
+	//!gain 10/256: 100 -> 104, 20/256: 108, 30/256: 112
+	CHECK(calib_set(0, 10, 0, 0));
+	CHECK(calib_save());
+	CHECK(calib_set(0, 20, 0, 0));
+	CHECK_EQ(calibrated(), 108);
+	CHECK(calib_load());
+	CHECK_EQ(calibrated(), 104);
+
+	CHECK(calib_set(0, 20, 0, 0));
+	CHECK(calib_save());
+	CHECK(calib_load());
+	CHECK_EQ(calibrated(), 108);
+
+	//!Сброс в каждой точке записи (при стирании, посреди данных, перед заголовком): загружается прежняя таблица
+	int limit = 0;
+	for (limit = 0; ; limit++)
+	{
+		CHECK(calib_set(0, 30, 0, 0));
+		writesLeft = limit;
+		int saved = calib_save();
+		writesLeft = -1;
+		CHECK(calib_load());
+		if (saved)
+			break;
+		CHECK_EQ(calibrated(), 108);
+		if (limit > 1000)
+			break;
+	}
+	CHECK(limit > 1);
+	CHECK_EQ(calibrated(), 112);
+	//!Следующая запись идёт в другую копию: сброс теперь возвращает 112
+	CHECK(calib_set(0, 40, 0, 0));
+	writesLeft = 1;
+	CHECK(!calib_save());
+	writesLeft = -1;
+	CHECK(calib_load());
+	CHECK_EQ(calibrated(), 112);
+	return TEST_RESULT("calib_test");
+}
@@ -0,0 +1,150 @@
+/*
+ * codec_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Код Хаффмана дельта-кадров журнала, как его использует хост: частоты разностей по первой половине
+ *      записанных снимков -> длины кодов (codec_huff_build) -> таблицы кодера и декодера. Вторая половина
+ *      кодируется и раскодируется обратно, размер сравнивается со значениями как есть и полубайтовой дельтой.
+ */
+
+#include "test.h"
+#include "codec.h"
+#include <string.h>
+
+#define SENSORS		1024
+#define SNAPSHOTS	64
+
+static int8_t snaps[SNAPSHOTS][SENSORS];
+static uint32_t seed = 1;
+
+static uint32_t next_random(void)
+{
+	seed = seed * 1103515245u + 12345u;
+	return seed >> 16;
+}
+
+//! Снимки, похожие на журнал: большинство датчиков стоит, часть уходит на градус, редкие скачки дальше escape
+static void make_snapshots(void)
+{
+	int f = 0, i = 0;
+	for (i = 0; i < SENSORS; i++)
+	{
+		snaps[0][i] = (int8_t)(20 + next_random() % 5);
+	}
+	for (f = 1; f < SNAPSHOTS; f++)
+	{
+		for (i = 0; i < SENSORS; i++)
+		{
+			uint32_t r = next_random() % 1000;
+			int d = r < 700 ? 0 : r < 850 ? 1 : r < 990 ? -1 : r < 997 ? 2 : (int)(next_random() % 80) - 40;
+			int v = snaps[f - 1][i] + d;
+			snaps[f][i] = (int8_t)(v > 120 ? 120 : v < -40 ? -40 : v);
+		}
+	}
+}
+
+static int max_length(const uint8_t *lengths)
+{
+	int s = 0, max = 0;
+	for (s = 0; s < CODEC_HUFF_SYMBOLS; s++)
+	{
+		max = lengths[s] > max ? lengths[s] : max;
+	}
+	return max;
+}
+
+//! Длины кодов крайних распределений частот: таблица строится всегда, коды не длиннее CODEC_HUFF_MAX_LEN
+static void check_build(void)
+{
+	uint32_t counts[CODEC_HUFF_SYMBOLS];
+	uint8_t lengths[CODEC_HUFF_SYMBOLS];
+	static HuffTable_t table;
+	static HuffDecoder_t decoder;
+	uint32_t a = 1, b = 1;
+	int s = 0;
+	//!Частоты Фибоначчи дают самое глубокое дерево: без сглаживания коды до 31 бита
+	for (s = 0; s < CODEC_HUFF_SYMBOLS; s++)
+	{
+		uint32_t c = a + b;
+		counts[s] = a;
+		a = b;
+		b = c;
+	}
+	codec_huff_build(counts, lengths);
+	CHECK(max_length(lengths) <= CODEC_HUFF_MAX_LEN);
+	CHECK(codec_huff_table(lengths, &table));
+	CHECK(codec_huff_decoder(lengths, &decoder));
+	//!Без данных код есть только у escape
+	memset(counts, 0, sizeof(counts));
+	codec_huff_build(counts, lengths);
+	CHECK(lengths[CODEC_HUFF_ESCAPE] > 0);
+	CHECK(codec_huff_table(lengths, &table));
+	//!Длины, не задающие префиксный код, и код без escape не принимаются
+	memset(lengths, 1, sizeof(lengths));
+	CHECK(!codec_huff_table(lengths, &table));
+	CHECK(!codec_huff_decoder(lengths, &decoder));
+	memset(lengths, 0, sizeof(lengths));
+	lengths[CODEC_HUFF_DELTA_MAX] = 1;
+	lengths[CODEC_HUFF_DELTA_MAX + 1] = 1;
+	CHECK(!codec_huff_table(lengths, &table));
+	lengths[CODEC_HUFF_DELTA_MAX + 1] = 2;
+	lengths[CODEC_HUFF_ESCAPE] = 2;
+	CHECK(codec_huff_table(lengths, &table));
+	lengths[CODEC_HUFF_DELTA_MAX] = CODEC_HUFF_MAX_LEN + 1;
+	CHECK(!codec_huff_table(lengths, &table));
+}
+
+int main(void)
+{
+	uint32_t counts[CODEC_HUFF_SYMBOLS];
+	uint8_t lengths[CODEC_HUFF_SYMBOLS];
+	static HuffTable_t table;
+	static HuffDecoder_t decoder;
+	static uint8_t huff[SENSORS * 2];
+	static uint8_t nibble[CODEC_DELTA_MAX(SENSORS)];
+	int8_t out[SENSORS];
+	long raw = 0, nibbles = 0, huffs = 0;
+	int f = 0, i = 0;
+	make_snapshots();
+	check_build();
+
+	memset(counts, 0, sizeof(counts));
+	for (f = 1; f < SNAPSHOTS / 2; f++)
+	{
+		for (i = 0; i < SENSORS; i++)
+		{
+			int s = snaps[f][i] - snaps[f - 1][i] + CODEC_HUFF_DELTA_MAX;
+			counts[s >= 0 && s < CODEC_HUFF_ESCAPE ? s : CODEC_HUFF_ESCAPE]++;
+		}
+	}
+	codec_huff_build(counts, lengths);
+	CHECK(max_length(lengths) <= CODEC_HUFF_MAX_LEN);
+	CHECK(codec_huff_table(lengths, &table));
+	CHECK(codec_huff_decoder(lengths, &decoder));
+
+	for (f = SNAPSHOTS / 2; f < SNAPSHOTS; f++)
+	{
+		int n = codec_huff_encode(&table, snaps[f], snaps[f - 1], SENSORS, huff, sizeof(huff));
+		int size = codec_delta_size(snaps[f], snaps[f - 1], SENSORS);
+		CHECK(n > 0);
+		CHECK_EQ(codec_delta_encode(snaps[f], snaps[f - 1], SENSORS, nibble), size);
+		CHECK(codec_delta_decode(nibble, size, snaps[f - 1], SENSORS, out));
+		CHECK(!memcmp(out, snaps[f], SENSORS));
+		memset(out, 0, sizeof(out));
+		CHECK(codec_huff_decode(&decoder, huff, n, snaps[f - 1], SENSORS, out));
+		CHECK(!memcmp(out, snaps[f], SENSORS));
+		//!Обрезанный поток не раскодируется, буфер меньше результата кодер не переполняет
+		CHECK(!codec_huff_decode(&decoder, huff, n - 2, snaps[f - 1], SENSORS, out));
+		CHECK_EQ(codec_huff_encode(&table, snaps[f], snaps[f - 1], SENSORS, huff, n - 1), 0);
+		raw += SENSORS;
+		nibbles += size;
+		huffs += n;
+	}
+	//!На таких данных код Хаффмана короче полубайтовой дельты, иначе журнал бы его не выбирал
+	CHECK(huffs < nibbles);
+	printf("codec_test: raw %ld, nibble delta %ld (%ld%%), huffman %ld (%ld%%) bytes\n",
+			raw, nibbles, nibbles * 100 / raw, huffs, huffs * 100 / raw);
+	return TEST_RESULT("codec_test");
+}
@@ -0,0 +1,145 @@
+/*
+ * lz_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Сжатие ответов LZSS: ответы разного вида сжимаются порциями, как по пути в очередь передачи канала,
+ *      и раскодируются codec_lz_decode. Печатаются степень сжатия и время кодера на байт (хост).
+ */
+
+#include "test.h"
+#include "codec.h"
+#include <string.h>
+#include <time.h>
+
+#define DATA_MAX	200000
+#define LZ_CHUNK	512		//!Как в main.c
+#define REPEATS		20		//!Проходов кодера для замера времени
+
+static uint8_t data[DATA_MAX];
+static uint8_t packed[CODEC_LZ_MAX(DATA_MAX) + 64];
+static uint8_t unpacked[DATA_MAX];
+static LzEncoder_t lz;
+static uint32_t seed = 3;
+
+static uint32_t next_random(void)
+{
+	seed = seed * 1103515245u + 12345u;
+	return seed >> 16;
+}
+
+//! Один поток: данные порциями не длиннее chunk (0 - случайной длины), каждая порция не длиннее CODEC_LZ_MAX
+static int compress(const uint8_t *in, int len, int chunk, uint8_t *out)
+{
+	int size = 0, i = 0;
+	codec_lz_begin(&lz);
+	while (i < len)
+	{
+		int n = chunk ? chunk : 1 + (int)(next_random() % 700);
+		n = n < len - i ? n : len - i;
+		int part = codec_lz_put(&lz, in + i, n, out + size);
+		CHECK(part <= CODEC_LZ_MAX(n));
+		size += part;
+		i += n;
+	}
+	return size + codec_lz_end(&lz, out + size);
+}
+
+//! Сжатие и раскодирование обратно, за потоком сразу второй поток (следующий ответ канала)
+static int round_trip(const uint8_t *in, int len, int chunk)
+{
+	static const uint8_t next[] = "@0000 0004\n+021+021+021+022\n";
+	int used = 0;
+	int size = compress(in, len, chunk, packed);
+	int size2 = compress(next, sizeof(next) - 1, chunk, packed + size);
+	int failed = testFailed;
+	CHECK_EQ(codec_lz_decode(packed, size + size2, unpacked, DATA_MAX, &used), len);
+	CHECK(!memcmp(unpacked, in, len));
+	CHECK_EQ(used, size);
+	CHECK_EQ(codec_lz_decode(packed + size, size2, unpacked, DATA_MAX, &used), sizeof(next) - 1);
+	CHECK(!memcmp(unpacked, next, sizeof(next) - 1));
+	CHECK_EQ(used, size2);
+	//!Оборванный поток и поток, не помещающийся в выходной буфер, не раскодируются
+	CHECK(codec_lz_decode(packed, size - 1, unpacked, DATA_MAX, &used) < 0);
+	CHECK(codec_lz_decode(packed, size, unpacked, len - 1, &used) < 0);
+	return testFailed == failed ? size : 0;
+}
+
+//! Степень сжатия и время кодера на байт порциями LZ_CHUNK
+static void measure(const char *name, int len)
+{
+	int size = round_trip(data, len, LZ_CHUNK);
+	int r = 0;
+	clock_t start = clock();
+	for (r = 0; r < REPEATS; r++)
+	{
+		compress(data, len, LZ_CHUNK, packed);
+	}
+	double ns = (double)(clock() - start) * 1e9 / CLOCKS_PER_SEC / ((double)len * REPEATS);
+	printf("lz_test: %-8s %6d -> %6d bytes (%3d%%), %.1f ns/byte\n", name, len, size, (int)((long)size * 100 / len), ns);
+}
+
+int main(void)
+{
+	int len = 0, f = 0, i = 0, k = 0;
+	int size = 0;
+	//!Поток без данных не занимает ни одного байта
+	codec_lz_begin(&lz);
+	CHECK_EQ(codec_lz_end(&lz, packed), 0);
+
+	//!Ответ read в MESS_CHAR: заголовок порции, значения "+021", карта карантина
+	for (f = 0; f < 12 && len < DATA_MAX - 20000; f++)
+	{
+		len += sprintf((char *)data + len, "@%04d 1024\n", f * 1024);
+		for (i = 0; i < 1024; i++)
+		{
+			len += sprintf((char *)data + len, "+%03d", 20 + (i % 7 == 0) + (next_random() % 50 == 0));
+		}
+		len += sprintf((char *)data + len, "\n0000000000000000\n");
+	}
+	measure("text", len);
+
+	//!Ответ history: заголовки кадров журнала и полубайтовые дельты, в основном нули
+	for (len = 0; len + 2060 < DATA_MAX; )
+	{
+		for (i = 0; i < 12; i++)
+		{
+			data[len++] = (uint8_t)next_random();
+		}
+		for (i = 0; i < 2048; i++)
+		{
+			uint32_t r = next_random() % 100;
+			data[len++] = r < 80 ? 0x00 : r < 95 ? 0x10 : 0x0F;
+		}
+	}
+	measure("history", len);
+
+	//!Несжимаемые данные: рост не больше бита на байт
+	for (len = 0; len < DATA_MAX; len++)
+	{
+		data[len] = (uint8_t)next_random();
+	}
+	measure("random", len);
+	size = compress(data, len, LZ_CHUNK, packed);
+	CHECK(size <= len * 9 / 8 + 4);
+
+	memset(data, 'x', 5000);
+	measure("runs", 5000);
+
+	//!Короткие потоки с повторами на границах порций случайной длины
+	for (k = 0; k < 500; k++)
+	{
+		len = 1 + (int)(next_random() % 3000);
+		for (i = 0; i < len; i++)
+		{
+			data[i] = (uint8_t)('a' + next_random() % (1 + k % 4));
+		}
+		if (!round_trip(data, len, 0))
+		{
+			printf("lz_test: stream %d (%d bytes) failed\n", k, len);
+			break;
+		}
+	}
+	return TEST_RESULT("lz_test");
+}
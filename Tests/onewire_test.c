@@ -0,0 +1,82 @@
+/*
+ * onewire_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Опрос 1-Wire с тиком короче преобразования: устройства посреди цикла отдаются как не опрошенные
+ *      (а не ошибкой, иначе датчик уходит в карантин), результат забирает один из следующих тиков.
+ */
+
+#include "test.h"
+#include "sensors.h"
+#include "analog.h"
+#include "i2ctemp.h"
+#include "onewire.h"
+#include <string.h>
+
+#define TICK_MS		100		//!Как у "poll 100 2000"
+#define TICKS		30		//!3 с - не меньше трёх циклов опроса
+#define ABSENT		(ONEWIRE_SENSORS - 1)	//!В имитации последнее устройство последней цепочки отсутствует
+
+int main(void)
+{
+	uint32_t set[SENSORS_SET_WORDS];
+	int8_t values[ONEWIRE_SENSORS];
+	uint8_t status[ONEWIRE_SENSORS];
+	int ok[ONEWIRE_SENSORS], fail[ONEWIRE_SENSORS];
+	int tick = 0, dev = 0, ms = 0;
+	CHECK(analog_init());
+	CHECK(i2ctemp_init());
+	CHECK(onewire_init());
+	CHECK(TICK_MS * 1000 < ONEWIRE_CONVERT_US);
+	memset(ok, 0, sizeof(ok));
+	memset(fail, 0, sizeof(fail));
+
+	//!Как процесс опроса: каждый тик все датчики шины в наборе, ожидание готовности не дольше тика, чтение
+	for (tick = 0; tick < TICKS; tick++)
+	{
+		memset(set, 0, sizeof(set));
+		for (dev = 0; dev < ONEWIRE_SENSORS; dev++)
+		{
+			set[(ONEWIRE_FIRST + dev) / 32] |= 1UL << ((ONEWIRE_FIRST + dev) % 32);
+		}
+		CHECK(sensors_begin(set, ONEWIRE_FIRST, ONEWIRE_SENSORS));
+		for (ms = 0; ms < TICK_MS && !sensors_ready(ONEWIRE_FIRST, ONEWIRE_SENSORS); ms++)
+		{
+			onewire_sim_advance(1000);
+		}
+		sensors_read(ONEWIRE_FIRST, ONEWIRE_SENSORS, values, status);
+		for (dev = 0; dev < ONEWIRE_SENSORS; dev++)
+		{
+			if (status[dev] == SENSOR_OK)
+			{
+				ok[dev]++;
+				CHECK_EQ(values[dev], 23 + dev);
+			}
+			else if (status[dev] == SENSOR_FAIL)
+			{
+				fail[dev]++;
+			}
+		}
+		//!Остаток тика
+		for (; ms < TICK_MS; ms++)
+		{
+			onewire_sim_advance(1000);
+		}
+	}
+	for (dev = 0; dev < ONEWIRE_SENSORS; dev++)
+	{
+		if (dev == ABSENT)
+		{
+			CHECK(fail[dev] >= 2);
+			CHECK_EQ(ok[dev], 0);
+			continue;
+		}
+		//!Цикл около 0.8 с: за 3 с каждое устройство прочитано не меньше трёх раз и ни разу не с ошибкой
+		CHECK(ok[dev] >= 3);
+		CHECK_EQ(fail[dev], 0);
+	}
+
+	return TEST_RESULT("onewire_test");
+}
@@ -0,0 +1,68 @@
+/*
+ * proto_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Кадры ответов двух каналов вперемешку (как при рассылке подписчикам): номера у каждого канала подряд,
+ *      nack повторяет кадр только своего канала, вытесненный из окна кадр не повторяется.
+ */
+
+#include "test.h"
+#include "proto.h"
+#include "mpuinit.h"
+
+#define FRAMES	5	//!Кадров на канал: оба канала помещаются в окно повтора
+
+//! Номер кадра из заголовка
+static uint16_t frame_seq(const uint8_t *f)
+{
+	return (uint16_t)(f[2] | (f[3] << 8));
+}
+
+int main(void)
+{
+	static uint8_t data[PROTO_PAYLOAD_MAX];
+	uint16_t seq[2] = { 0, 0 };
+	const uint8_t *frame = NULL;
+	int i = 0, link = 0;
+	CHECK(proto_init());
+	CHECK_EQ(proto_frame(0, 0, 1, 0, data, PROTO_PAYLOAD_MAX + 1, &frame), 0);
+
+	//!Канал 0 начинает со своих номеров раньше канала 1: номера совпадают, кадры разные
+	for (i = 0; i < FRAMES; i++)
+	{
+		for (link = 0; link < 2; link++)
+		{
+			data[0] = (uint8_t)(link * 16 + i);
+			int size = proto_frame((uint8_t)link, seq[link]++, 1, 7, data, 1, &frame);
+			CHECK_EQ(size, PROTO_HEADER + 1 + PROTO_CRC);
+			CHECK_EQ(frame_seq(frame), i);
+			CHECK_EQ(crc32_calc(frame, PROTO_HEADER + 1), frame[PROTO_HEADER + 1] | (frame[PROTO_HEADER + 2] << 8) |
+					(frame[PROTO_HEADER + 3] << 16) | ((uint32_t)frame[PROTO_HEADER + 4] << 24));
+		}
+	}
+	for (i = 0; i < FRAMES; i++)
+	{
+		for (link = 0; link < 2; link++)
+		{
+			CHECK_EQ(proto_resend((uint8_t)link, (uint16_t)i, &frame), PROTO_HEADER + 1 + PROTO_CRC);
+			CHECK_EQ(frame[PROTO_HEADER], link * 16 + i);
+		}
+	}
+	CHECK_EQ(proto_resend(0, FRAMES, &frame), 0);
+	CHECK_EQ(proto_resend(2, 0, &frame), 0);
+
+	//!Длинные кадры канала 1 проходят окно целиком и вытесняют все кадры канала 0
+	for (i = 0; i <= PROTO_WINDOW_SIZE / PROTO_PAYLOAD_MAX; i++)
+	{
+		CHECK(proto_frame(1, seq[1]++, 1, 7, data, PROTO_PAYLOAD_MAX, &frame));
+	}
+	for (i = 0; i < FRAMES; i++)
+	{
+		CHECK_EQ(proto_resend(0, (uint16_t)i, &frame), 0);
+	}
+	CHECK_EQ(proto_resend(1, (uint16_t)(seq[1] - 1), &frame), PROTO_HEADER + PROTO_PAYLOAD_MAX + PROTO_CRC);
+	CHECK_EQ(frame_seq(frame), seq[1] - 1);
+	return TEST_RESULT("proto_test");
+}
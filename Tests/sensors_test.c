@@ -0,0 +1,87 @@
+/*
+ * sensors_test.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Пакетный опрос через sensors_begin/sensors_ready/sensors_read на имитации шины I2C:
+ *      значения, ошибка отсутствующего устройства, сброс результата после чтения и длительность цепочки.
+ */
+
+#include "test.h"
+#include "sensors.h"
+#include "analog.h"
+#include "i2ctemp.h"
+#include "onewire.h"
+#include <string.h>
+
+//!Время на проводе имитации: чтение регистра - 48 бит, NACK на адрес - 11 бит, бит - 2.5 мкс
+#define READ_US		(48 * 5 / 2)
+#define NACK_US		(11 * 5 / 2)
+
+static uint32_t set[SENSORS_SET_WORDS];
+static int8_t values[I2CTEMP_SENSORS];
+static uint8_t status[I2CTEMP_SENSORS];
+
+//! Опрос устройств I2C с номерами из mask (бит i - устройство i)
+static void poll_i2c(uint32_t mask)
+{
+	int i = 0, spins = 0;
+	memset(set, 0, sizeof(set));
+	for (i = 0; i < I2CTEMP_SENSORS; i++)
+	{
+		if (mask & (1UL << i))
+		{
+			set[(I2CTEMP_FIRST + i) / 32] |= 1UL << ((I2CTEMP_FIRST + i) % 32);
+		}
+	}
+	CHECK(sensors_begin(set, I2CTEMP_FIRST, I2CTEMP_SENSORS));
+	while (!sensors_ready(I2CTEMP_FIRST, I2CTEMP_SENSORS) && spins < 100)
+	{
+		spins++;
+	}
+	CHECK(spins < 100);
+	sensors_read(I2CTEMP_FIRST, I2CTEMP_SENSORS, values, status);
+}
+
+int main(void)
+{
+	uint32_t stats[I2CTEMP_STATS];
+	int i = 0;
+	CHECK(analog_init());
+	CHECK(i2ctemp_init());
+	CHECK(onewire_init());
+
+	//!Все устройства: имитация отдаёт 20 + (адрес & 7) и половину градуса, последнее устройство не отвечает
+	poll_i2c((1UL << I2CTEMP_SENSORS) - 1);
+	for (i = 0; i < I2CTEMP_SENSORS - 1; i++)
+	{
+		CHECK_EQ(status[i], SENSOR_OK);
+		CHECK_EQ(values[i], 20 + ((I2CTEMP_ADDR_FIRST + i) & 7) + 1);
+	}
+	CHECK_EQ(status[I2CTEMP_SENSORS - 1], SENSOR_FAIL);
+	i2ctemp_stats(stats);
+	CHECK_EQ(stats[I2CTEMP_READS], I2CTEMP_SENSORS - 1);
+	CHECK_EQ(stats[I2CTEMP_ERRORS], 1);
+	CHECK_EQ(stats[I2CTEMP_TIME_US], (I2CTEMP_SENSORS - 1) * READ_US + NACK_US);
+
+	//!Результат отдаётся один раз: без нового запуска устройства не читались
+	sensors_read(I2CTEMP_FIRST, I2CTEMP_SENSORS, values, status);
+	for (i = 0; i < I2CTEMP_SENSORS; i++)
+	{
+		CHECK_EQ(status[i], SENSOR_SKIP);
+	}
+
+	//!Часть устройств: цепочка читает только запрошенные
+	poll_i2c(0x0A);
+	for (i = 0; i < I2CTEMP_SENSORS; i++)
+	{
+		CHECK_EQ(status[i], (0x0A & (1UL << i)) ? SENSOR_OK : SENSOR_SKIP);
+	}
+	i2ctemp_stats(stats);
+	CHECK_EQ(stats[I2CTEMP_READS], 2);
+	CHECK_EQ(stats[I2CTEMP_ERRORS], 0);
+	CHECK_EQ(stats[I2CTEMP_TIME_US], 2 * READ_US);
+
+	return TEST_RESULT("sensors_test");
+}
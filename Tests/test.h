@@ -0,0 +1,24 @@
+/*
+ * test.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Yury
+ *
+ *      Проверки хостовых тестов: неудачная проверка печатается с местом в исходнике,
+ *      тест возвращает количество неудачных проверок (0 - успех).
+ */
+
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <stdio.h>
+
+static int testFailed = 0;
+
+#define CHECK(cond)	do { if (!(cond)) { printf("%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #cond); testFailed++; } } while (0)
+#define CHECK_EQ(a, b)	do { long long a_ = (long long)(a), b_ = (long long)(b); if (a_ != b_) \
+							{ printf("%s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #a, a_, b_); testFailed++; } } while (0)
+
+#define TEST_RESULT(name)	(printf("%s: %s\n", name, testFailed ? "FAIL" : "OK"), testFailed)
+
+#endif /* TEST_H_ */